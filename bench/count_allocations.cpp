@@ -0,0 +1,62 @@
+// Replaces the global operator new and delete to count heap allocations into
+// perf::allocations(). Linked into the benchmarks as an object library, and
+// into the application only when built with COUNT_FRAME_ALLOCATIONS, where
+// COUNT_THREAD_ALLOCATIONS_ONLY leaves out the process wide atomics every
+// thread would contend on.
+
+#include <cstdlib>
+#include <new>
+
+#include "perf/allocations.h"
+
+namespace {
+
+void count(std::size_t size) {
+#ifdef COUNT_THREAD_ALLOCATIONS_ONLY
+    perf::detail::count_thread_allocation(size);
+#else
+    perf::detail::count_allocation(size);
+#endif
+}
+
+void* counted_alloc(std::size_t size) {
+    count(size);
+    if (auto* p = std::malloc(size == 0 ? 1 : size)) {
+        return p;
+    }
+    throw std::bad_alloc{};
+}
+
+void* counted_alloc(std::size_t size, std::align_val_t alignment) {
+    count(size);
+    const auto align = static_cast<std::size_t>(alignment);
+    // aligned_alloc wants the size to be a multiple of the alignment
+    const auto padded = (size + align - 1) / align * align;
+    if (auto* p = std::aligned_alloc(align, padded == 0 ? align : padded)) {
+        return p;
+    }
+    throw std::bad_alloc{};
+}
+
+}  // namespace
+
+void* operator new(std::size_t size) { return counted_alloc(size); }
+void* operator new[](std::size_t size) { return counted_alloc(size); }
+void* operator new(std::size_t size, std::align_val_t alignment) {
+    return counted_alloc(size, alignment);
+}
+void* operator new[](std::size_t size, std::align_val_t alignment) {
+    return counted_alloc(size, alignment);
+}
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete[](void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+void operator delete[](void* p, std::size_t) noexcept { std::free(p); }
+void operator delete(void* p, std::align_val_t) noexcept { std::free(p); }
+void operator delete[](void* p, std::align_val_t) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t, std::align_val_t) noexcept {
+    std::free(p);
+}
+void operator delete[](void* p, std::size_t, std::align_val_t) noexcept {
+    std::free(p);
+}
@@ -0,0 +1,98 @@
+#include "harness.h"
+
+#include <sys/resource.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <iostream>
+
+#include <opencv2/core/utils/allocator_stats.hpp>
+#include <opencv2/opencv.hpp>
+
+#include "perf/allocations.h"
+
+namespace bench {
+
+std::uint64_t allocation_count() {
+    return perf::allocations().count +
+           cv::getAllocatorStatistics().getNumberOfAllocations();
+}
+
+std::uint64_t allocated_bytes() {
+    return perf::allocations().bytes +
+           cv::getAllocatorStatistics().getTotalUsage();
+}
+
+Result run(std::string name, const std::function<void()>& op,
+           std::chrono::milliseconds min_time) {
+    using clock = std::chrono::steady_clock;
+
+    op();
+
+    std::uint64_t iterations = 1;
+    while (true) {
+        const auto count_before = allocation_count();
+        const auto bytes_before = allocated_bytes();
+        const auto tp_before = clock::now();
+        for (std::uint64_t i = 0; i < iterations; ++i) {
+            op();
+        }
+        const auto elapsed = clock::now() - tp_before;
+
+        if (elapsed >= min_time || iterations >= (1ull << 30)) {
+            const auto n = static_cast<double>(iterations);
+            return Result{
+                .name = std::move(name),
+                .iterations = iterations,
+                .ns_per_op =
+                    std::chrono::duration<double, std::nano>(elapsed).count() /
+                    n,
+                .bytes_per_op = (allocated_bytes() - bytes_before) / n,
+                .allocs_per_op = (allocation_count() - count_before) / n};
+        }
+        iterations *= 2;
+    }
+}
+
+void print_header() {
+    std::printf("%-44s %12s %14s %12s %10s\n", "benchmark", "iterations",
+                "ns/op", "bytes/op", "allocs/op");
+}
+
+void print(const Result& result) {
+    std::printf("%-44s %12llu %14.1f %12.1f %10.2f\n", result.name.c_str(),
+                static_cast<unsigned long long>(result.iterations),
+                result.ns_per_op, result.bytes_per_op, result.allocs_per_op);
+    std::fflush(stdout);
+}
+
+std::optional<vision::ModelType> parse_model_type(std::string_view type) {
+    if (type == "yolov5") {
+        return vision::ModelType::YOLOv5;
+    }
+    if (type == "yolov8") {
+        return vision::ModelType::YOLOv8;
+    }
+    std::cerr << "Unknown model type: " << type << "\n";
+    return std::nullopt;
+}
+
+std::chrono::duration<double> process_cpu_time() {
+    rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    const auto to_duration = [](const timeval& tv) {
+        return std::chrono::duration<double>(tv.tv_sec + tv.tv_usec * 1e-6);
+    };
+    return to_duration(usage.ru_utime) + to_duration(usage.ru_stime);
+}
+
+double percentile(std::vector<double> samples, double p) {
+    if (samples.empty()) {
+        return 0.0;
+    }
+    const auto k = static_cast<std::size_t>(p * (samples.size() - 1));
+    std::nth_element(samples.begin(), samples.begin() + k, samples.end());
+    return samples[k];
+}
+
+}  // namespace bench
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "vision/factory.h"
+#include "vision/parsers/parser.h"
+
+namespace bench {
+
+// the thresholds the application detects with
+inline const auto THRESHOLDS =
+    vision::Thresholds{.score = 0.35f, .nms = 0.45f, .objectness = 0.25f};
+
+struct Result {
+    std::string name;
+    std::uint64_t iterations;
+    double ns_per_op;
+    double bytes_per_op;
+    double allocs_per_op;
+};
+
+// Heap allocations since process start, both through the global operator
+// new and through the OpenCV allocator cv::Mat buffers come from
+std::uint64_t allocation_count();
+std::uint64_t allocated_bytes();
+
+// Calls op once to warm up, then in growing batches until the batch runs for
+// at least min_time
+Result run(std::string name, const std::function<void()>& op,
+           std::chrono::milliseconds min_time = std::chrono::milliseconds{300});
+
+void print_header();
+void print(const Result& result);
+
+// a --type value, yolov5 or yolov8; reports anything else and returns
+// nullopt
+std::optional<vision::ModelType> parse_model_type(std::string_view type);
+
+// user and system time of all threads of the process so far
+std::chrono::duration<double> process_cpu_time();
+
+// the sample at p of the sorted samples, 0 if there are none
+double percentile(std::vector<double> samples, double p);
+
+// keeps the optimizer from dropping a result that is never read
+template <typename T>
+void do_not_optimize(const T& value) {
+    asm volatile("" : : "r,m"(value) : "memory");
+}
+
+}  // namespace bench
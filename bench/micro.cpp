@@ -0,0 +1,376 @@
+// Microbenchmarks of the vision hot paths on synthetic deterministic inputs
+// at the sizes the application runs with. Pass a substring to run only the
+// matching benchmarks. The "steady" ones reuse their buffers and a frame
+// arena like the detector does from frame to frame; with --assert-no-alloc
+// the run fails if any of them allocates more than it has to. That covers
+// Detector::input, forward and parse with the model's output stubbed out,
+// where only the returned detections may allocate. The rest of a pipeline
+// frame isn't covered: the snapshot, the copies of the detections and
+// their depth stats are allocated per frame.
+//
+//   bench_micro [<filter>] [--assert-no-alloc]
+
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <opencv2/opencv.hpp>
+
+#include "bench/harness.h"
+#include "vision/camera.h"
+#include "vision/depth.h"
+#include "vision/detector.h"
+#include "vision/detail/letterbox.h"
+#include "vision/detail/nms.h"
+#include "vision/frame_arena.h"
+#include "vision/parsers/yolov5.h"
+#include "vision/parsers/yolov8.h"
+
+namespace {
+
+constexpr int FRAME_W = 848;
+constexpr int FRAME_H = 480;
+constexpr int INPUT_W = 640;
+constexpr int INPUT_H = 640;
+constexpr int CLASS_NUM = 80;
+constexpr int OBJECTS_NUM = 20;
+constexpr int ANCHORS_PER_OBJECT = 12;
+
+const auto LETTERBOX_COLOR = cv::Scalar(114, 114, 114);
+using bench::THRESHOLDS;
+
+cv::Mat make_color(cv::RNG& rng) {
+    cv::Mat color(FRAME_H, FRAME_W, CV_8UC3);
+    rng.fill(color, cv::RNG::UNIFORM, 0, 256);
+    return color;
+}
+
+// 0.3 to 4 m at 1 mm units with about a tenth of the pixels invalid
+cv::Mat make_depth(cv::RNG& rng) {
+    cv::Mat depth(FRAME_H, FRAME_W, CV_16U);
+    rng.fill(depth, cv::RNG::UNIFORM, 300, 4000);
+    for (int y = 0; y < depth.rows; ++y) {
+        auto* row = depth.ptr<uint16_t>(y);
+        for (int x = 0; x < depth.cols; ++x) {
+            if (rng.uniform(0, 10) == 0) {
+                row[x] = 0;
+            }
+        }
+    }
+    return depth;
+}
+
+struct Candidate {
+    int anchor;
+    int class_id;
+    float score;
+    cv::Rect2f box;  // center and size in letterbox pixels
+};
+
+// A few objects, each detected by a cluster of overlapping anchors, so that
+// NMS has work to do, over a background of low scores
+std::vector<Candidate> make_candidates(cv::RNG& rng, int anchors_num) {
+    std::vector<Candidate> candidates;
+    for (int o = 0; o < OBJECTS_NUM; ++o) {
+        const auto class_id = rng.uniform(0, CLASS_NUM);
+        const auto box = cv::Rect2f(
+            rng.uniform(50.f, 590.f), rng.uniform(150.f, 490.f),
+            rng.uniform(20.f, 200.f), rng.uniform(20.f, 200.f));
+        for (int a = 0; a < ANCHORS_PER_OBJECT; ++a) {
+            candidates.push_back(Candidate{
+                .anchor = rng.uniform(0, anchors_num),
+                .class_id = class_id,
+                .score = rng.uniform(0.4f, 0.95f),
+                .box = cv::Rect2f(box.x + rng.uniform(-4.f, 4.f),
+                                  box.y + rng.uniform(-4.f, 4.f),
+                                  box.width * rng.uniform(0.9f, 1.1f),
+                                  box.height * rng.uniform(0.9f, 1.1f))});
+        }
+    }
+    return candidates;
+}
+
+// 1 x 84 x 8400, channels first
+cv::Mat make_yolov8_output(cv::RNG& rng) {
+    const int features = CLASS_NUM + 4;
+    const int anchors = (INPUT_W / 8) * (INPUT_H / 8) +
+                        (INPUT_W / 16) * (INPUT_H / 16) +
+                        (INPUT_W / 32) * (INPUT_H / 32);
+    const int sizes[] = {1, features, anchors};
+    cv::Mat output(3, sizes, CV_32F);
+
+    auto* data = output.ptr<float>();
+    for (int c = 0; c < features; ++c) {
+        const auto high = c < 4 ? static_cast<float>(INPUT_W) : 0.05f;
+        for (int i = 0; i < anchors; ++i) {
+            data[c * anchors + i] = rng.uniform(0.f, high);
+        }
+    }
+    for (const auto& candidate : make_candidates(rng, anchors)) {
+        const auto i = candidate.anchor;
+        data[0 * anchors + i] = candidate.box.x;
+        data[1 * anchors + i] = candidate.box.y;
+        data[2 * anchors + i] = candidate.box.width;
+        data[3 * anchors + i] = candidate.box.height;
+        data[(4 + candidate.class_id) * anchors + i] = candidate.score;
+    }
+    return output;
+}
+
+// 1 x 25200 x 85, anchors first
+cv::Mat make_yolov5_output(cv::RNG& rng) {
+    const int dims = CLASS_NUM + 5;
+    const int anchors = 3 * ((INPUT_W / 8) * (INPUT_H / 8) +
+                             (INPUT_W / 16) * (INPUT_H / 16) +
+                             (INPUT_W / 32) * (INPUT_H / 32));
+    const int sizes[] = {1, anchors, dims};
+    cv::Mat output(3, sizes, CV_32F);
+
+    auto* data = output.ptr<float>();
+    for (int i = 0; i < anchors; ++i) {
+        auto* row = data + i * dims;
+        for (int d = 0; d < dims; ++d) {
+            row[d] = rng.uniform(0.f, d < 4 ? static_cast<float>(INPUT_W)
+                                            : 0.05f);
+        }
+    }
+    for (const auto& candidate : make_candidates(rng, anchors)) {
+        auto* row = data + candidate.anchor * dims;
+        row[0] = candidate.box.x;
+        row[1] = candidate.box.y;
+        row[2] = candidate.box.width;
+        row[3] = candidate.box.height;
+        row[4] = 0.98f;
+        row[5 + candidate.class_id] = candidate.score;
+    }
+    return output;
+}
+
+// the model replaced by a tensor it could have produced
+class FixedEngine : public vision::InferenceEngine {
+   public:
+    explicit FixedEngine(cv::Mat output) : _output(std::move(output)) {}
+
+    void set_input(cv::Mat) override {}
+    cv::Mat forward() override { return _output; }
+
+   private:
+    cv::Mat _output;
+};
+
+// short enough for the small string buffer, like most of the COCO ones
+std::vector<std::string> make_labels() {
+    std::vector<std::string> labels;
+    for (int i = 0; i < CLASS_NUM; ++i) {
+        labels.push_back("class " + std::to_string(i));
+    }
+    return labels;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    auto filter = std::string_view{};
+    auto is_no_alloc_asserted = false;
+    for (int i = 1; i < argc; ++i) {
+        const auto arg = std::string_view{argv[i]};
+        if (arg == "--assert-no-alloc") {
+            is_no_alloc_asserted = true;
+        } else {
+            filter = arg;
+        }
+    }
+    const auto is_selected = [filter](std::string_view name) {
+        return name.find(filter) != std::string_view::npos;
+    };
+
+    // single threaded numbers are easier to compare between changes
+    cv::setNumThreads(1);
+
+    cv::RNG rng(0x5eed);
+    const auto color = make_color(rng);
+    const auto depth = make_depth(rng);
+    cv::Mat ir;
+    cv::cvtColor(color, ir, cv::COLOR_BGR2GRAY);
+    const auto yolov8_output = make_yolov8_output(rng);
+    const auto yolov5_output = make_yolov5_output(rng);
+
+    const auto yolov8 = vision::YOLOv8Parser(CLASS_NUM, INPUT_W, INPUT_H);
+    const auto yolov5 = vision::YOLOv5Parser(CLASS_NUM, INPUT_W, INPUT_H);
+    const auto raw = yolov8.parse(yolov8_output, THRESHOLDS);
+
+    const auto letterbox =
+        img_to_letterbox(color, INPUT_W, INPUT_H, LETTERBOX_COLOR);
+
+    auto detector = vision::Detector(vision::ModelRuntime{
+        .engine = std::make_unique<FixedEngine>(yolov8_output),
+        .labels = make_labels(),
+        .parser =
+            std::make_unique<vision::YOLOv8Parser>(CLASS_NUM, INPUT_W, INPUT_H),
+        .input_w = INPUT_W,
+        .input_h = INPUT_H,
+        .letterbox_color = LETTERBOX_COLOR});
+    // parse works on the outputs of the frame before
+    detector.input(color);
+    detector.forward();
+
+    bench::print_header();
+    std::vector<std::string> allocating;
+    // steady state benchmarks pass the allocations per op they may not exceed
+    const auto run = [&](std::string name, const std::function<void()>& op,
+                         std::optional<double> max_allocs = std::nullopt) {
+        if (!is_selected(name)) {
+            return;
+        }
+        const auto result = bench::run(std::move(name), op);
+        bench::print(result);
+        if (max_allocs.has_value() && result.allocs_per_op > *max_allocs) {
+            allocating.push_back(result.name);
+        }
+    };
+
+    // reused across iterations like across the frames of a detector
+    auto arena = vision::FrameArena();
+    Letterbox reused_letterbox;
+    cv::Mat reused_resized;
+    cv::Mat reused_blob;
+    const auto full_frame = cv::Rect(0, 0, FRAME_W, FRAME_H);
+
+    run("img_to_letterbox 848x480->640x640", [&] {
+        bench::do_not_optimize(
+            img_to_letterbox(color, INPUT_W, INPUT_H, LETTERBOX_COLOR));
+    });
+
+    run("Detector::preprocess 848x480->1x3x640x640", [&] {
+        const auto lb =
+            img_to_letterbox(color, INPUT_W, INPUT_H, LETTERBOX_COLOR);
+        bench::do_not_optimize(letterbox_to_blob(lb));
+    });
+
+    run("letterbox_to_blob 640x640", [&] {
+        bench::do_not_optimize(letterbox_to_blob(letterbox));
+    });
+
+    run(
+        "steady img_to_letterbox 848x480->640x640",
+        [&] {
+            img_to_letterbox(color, full_frame, INPUT_W, INPUT_H,
+                             LETTERBOX_COLOR, reused_letterbox,
+                             reused_resized);
+            bench::do_not_optimize(reused_letterbox);
+        },
+        0.0);
+
+    // the OpenCV path letterbox_to_blob replaces
+    run("cv::dnn::blobFromImage 640x640", [&] {
+        bench::do_not_optimize(cv::dnn::blobFromImage(
+            letterbox.data, 1.0 / 255.0, cv::Size(), cv::Scalar(), true));
+    });
+
+    run("cv::dnn::blobFromImage reused 640x640", [&] {
+        cv::dnn::blobFromImage(letterbox.data, reused_blob, 1.0 / 255.0,
+                               cv::Size(), cv::Scalar(), true);
+        bench::do_not_optimize(reused_blob);
+    });
+
+    run(
+        "steady letterbox_to_blob 640x640",
+        [&] {
+            letterbox_to_blob(letterbox, reused_blob);
+            bench::do_not_optimize(reused_blob);
+        },
+        0.0);
+
+    run("YOLOv8Parser::parse 1x84x8400", [&] {
+        bench::do_not_optimize(yolov8.parse(yolov8_output, THRESHOLDS));
+    });
+
+    run("YOLOv5Parser::parse 1x25200x85", [&] {
+        bench::do_not_optimize(yolov5.parse(yolov5_output, THRESHOLDS));
+    });
+
+    run(
+        "steady YOLOv8Parser::parse 1x84x8400",
+        [&] {
+            bench::do_not_optimize(
+                yolov8.parse(yolov8_output, THRESHOLDS, arena.resource()));
+            arena.reset();
+        },
+        0.0);
+
+    run("apply_nms class agnostic " + std::to_string(raw.boxes.size()), [&] {
+        bench::do_not_optimize(apply_nms(raw, THRESHOLDS, CLASS_NUM, true));
+    });
+
+    run("apply_nms class aware " + std::to_string(raw.boxes.size()), [&] {
+        bench::do_not_optimize(apply_nms(raw, THRESHOLDS, CLASS_NUM, false));
+    });
+
+    run(
+        "steady apply_nms " + std::to_string(raw.boxes.size()),
+        [&] {
+            bench::do_not_optimize(apply_nms(raw, THRESHOLDS, CLASS_NUM, false,
+                                             arena.resource()));
+            arena.reset();
+        },
+        0.0);
+
+    for (const auto size : {16, 64, 256, 480}) {
+        const auto roi =
+            cv::Rect((FRAME_W - size) / 2, (FRAME_H - size) / 2, size, size);
+        run("get_median_depth " + std::to_string(size) + "x" +
+                std::to_string(size),
+            [&] {
+                bench::do_not_optimize(
+                    vision::get_median_depth(depth, roi, 0.001f));
+            });
+        run(
+            "steady get_depth_stats " + std::to_string(size) + "x" +
+                std::to_string(size),
+            [&] {
+                bench::do_not_optimize(vision::get_depth_stats(
+                    depth, roi, 0.001f, arena.resource()));
+                arena.reset();
+            },
+            0.0);
+    }
+
+    run(
+        "steady Detector::input+forward 848x480->1x84x8400",
+        [&] {
+            detector.input(color);
+            detector.forward();
+        },
+        0.0);
+
+    // the returned vector, the labels fit the small string buffer
+    run(
+        "steady Detector::parse 1x84x8400",
+        [&] { bench::do_not_optimize(detector.parse(THRESHOLDS)); }, 1.0);
+
+    // what a pooled camera does with every frameset; the frames go back to
+    // the pool at the end of each iteration
+    auto pool = vision::FramePool(vision::frames_slab_size(color, depth, ir));
+    unsigned long long number = 0;
+    run("copy_to_pool 848x480 color+depth+ir", [&] {
+        bench::do_not_optimize(vision::copy_to_pool(
+            pool, color, depth, ir, 0.001f, ++number, 0.0, {}));
+    });
+
+    // only the bookkeeping around images which are already there
+    run("Frames wrapping cv::Mat", [&] {
+        bench::do_not_optimize(
+            vision::Frames(color, depth, ir, 0.001f, ++number, 0.0));
+    });
+
+    for (const auto& name : allocating) {
+        std::printf("steady state allocates: %s\n", name.c_str());
+    }
+    return is_no_alloc_asserted && !allocating.empty() ? EXIT_FAILURE
+                                                       : EXIT_SUCCESS;
+}
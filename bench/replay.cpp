@@ -0,0 +1,615 @@
+// End-to-end benchmark: replays a .bag recording or synthetic frames through
+// the same Pipeline the application runs (capture, detector, depth stats)
+// plus a raster overlay of the detections, and writes a JSON report. Two
+// reports can be compared to catch regressions between builds. With
+// --sweep-cores the run is repeated for a range of OpenCV pool sizes and
+// core pinnings and a table with the best latency and throughput is printed
+// instead of the report.
+//
+//   bench_replay [--bag <path> [--frame-pool]] [--frames N] [--warmup N]
+//                [--fps F] [--tracking] [--motion-gate T]
+//                [--roi [--roi-size PX]] [--depth-range MIN MAX]
+//                [--model <onnx>] [--labels <names>] [--type yolov5|yolov8]
+//                [--dynamic-input]
+//                [--tensors <path> [--latency MS] | --record-tensors <path>]
+//                [--cv-threads N] [--capture-cores <list>]
+//                [--inference-cores <list>] [--capture-priority]
+//                [--sweep-cores] [--output <report.json|->]
+//   bench_replay --compare <baseline.json> <candidate.json> [--tolerance T]
+
+#include <sys/resource.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <numeric>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include <plog/Formatters/TxtFormatter.h>
+#include <plog/Initializers/ConsoleInitializer.h>
+#include <plog/Log.h>
+#include <opencv2/opencv.hpp>
+
+#include "bench/harness.h"
+#include "perf/metrics.h"
+#include "vision/camera.h"
+#include "vision/core_budget.h"
+#include "vision/detector.h"
+#include "vision/engines/opencv_dnn.h"
+#include "vision/engines/replay.h"
+#include "vision/factory.h"
+#include "vision/pipeline.h"
+#include "vision/synthetic_scene.h"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+struct Options {
+    // empty for synthetic frames
+    std::string bag_path;
+    // copies recorded frames into recycled buffers like the application can
+    bool is_frame_pool_enabled = false;
+    int frames = 300;
+    // frames excluded from the statistics while caches and the model warm up
+    int warmup = 10;
+    // 0 delivers synthetic frames as fast as they are consumed
+    float fps = 0.f;
+    bool is_tracking_enabled = false;
+    std::optional<float> motion_threshold;
+    bool is_roi_enabled = false;
+    // square size crops are letterboxed to, 0 for the model's input size
+    int roi_size = 0;
+    std::optional<std::pair<float, float>> depth_range;
+    std::string model_path = "yolov12n.onnx";
+    std::string labels_path = "coco.names";
+    vision::ModelType model_type = vision::ModelType::YOLOv8;
+    // the model was exported with dynamic axes and takes any input size
+    bool is_input_dynamic = false;
+    // recorded output tensors replace the model when set
+    std::string tensors_path;
+    // how long a replayed forward pass takes
+    std::chrono::microseconds latency{0};
+    // saves the model outputs for later --tensors runs
+    std::string record_tensors_path;
+    vision::CoreBudgetConfig core_budget;
+    // measures every budget from sweep_budgets() instead
+    bool is_core_sweep = false;
+    std::string output = "-";
+
+    std::optional<std::pair<std::string, std::string>> compare;
+    // relative change tolerated before a metric counts as a regression
+    double tolerance = 0.05;
+};
+
+void print_usage(const char* name) {
+    std::cerr << "Usage: " << name
+              << " [--bag <path> [--frame-pool]] [--frames N] [--warmup N]"
+                 " [--fps F]\n"
+                 "       [--tracking] [--motion-gate T]"
+                 " [--roi [--roi-size PX]] [--depth-range MIN MAX]\n"
+                 "       [--model <onnx>] [--labels <names>]"
+                 " [--type yolov5|yolov8] [--dynamic-input]\n"
+                 "       [--tensors <path> [--latency MS] |"
+                 " --record-tensors <path>]\n"
+                 "       [--cv-threads N] [--capture-cores <list>]"
+                 " [--inference-cores <list>]\n"
+                 "       [--capture-priority] [--sweep-cores]"
+                 " [--output <report.json|->]\n"
+              << "       " << name
+              << " --compare <baseline.json> <candidate.json>"
+                 " [--tolerance T]\n";
+}
+
+std::optional<Options> parse_options(int argc, char** argv) {
+    Options options;
+    for (int i = 1; i < argc; ++i) {
+        const auto arg = std::string_view{argv[i]};
+        const auto has_value = i + 1 < argc;
+        if (arg == "--bag" && has_value) {
+            options.bag_path = argv[++i];
+        } else if (arg == "--frame-pool") {
+            options.is_frame_pool_enabled = true;
+        } else if (arg == "--frames" && has_value) {
+            options.frames = std::stoi(argv[++i]);
+        } else if (arg == "--warmup" && has_value) {
+            options.warmup = std::stoi(argv[++i]);
+        } else if (arg == "--fps" && has_value) {
+            options.fps = std::stof(argv[++i]);
+        } else if (arg == "--tracking") {
+            options.is_tracking_enabled = true;
+        } else if (arg == "--motion-gate" && has_value) {
+            options.motion_threshold = std::stof(argv[++i]);
+        } else if (arg == "--depth-range" && i + 2 < argc) {
+            options.depth_range = std::pair{std::stof(argv[i + 1]),
+                                            std::stof(argv[i + 2])};
+            i += 2;
+        } else if (arg == "--roi") {
+            options.is_roi_enabled = true;
+        } else if (arg == "--roi-size" && has_value) {
+            options.roi_size = std::stoi(argv[++i]);
+        } else if (arg == "--model" && has_value) {
+            options.model_path = argv[++i];
+        } else if (arg == "--labels" && has_value) {
+            options.labels_path = argv[++i];
+        } else if (arg == "--type" && has_value) {
+            const auto type = bench::parse_model_type(argv[++i]);
+            if (!type.has_value()) {
+                return std::nullopt;
+            }
+            options.model_type = *type;
+        } else if (arg == "--dynamic-input") {
+            options.is_input_dynamic = true;
+        } else if (arg == "--tensors" && has_value) {
+            options.tensors_path = argv[++i];
+        } else if (arg == "--latency" && has_value) {
+            options.latency = std::chrono::microseconds{
+                static_cast<long>(std::stod(argv[++i]) * 1000.0)};
+        } else if (arg == "--record-tensors" && has_value) {
+            options.record_tensors_path = argv[++i];
+        } else if (arg == "--cv-threads" && has_value) {
+            options.core_budget.cv_threads = std::stoi(argv[++i]);
+        } else if (arg == "--capture-cores" && has_value) {
+            options.core_budget.capture_cores = vision::parse_cores(argv[++i]);
+        } else if (arg == "--inference-cores" && has_value) {
+            options.core_budget.inference_cores =
+                vision::parse_cores(argv[++i]);
+        } else if (arg == "--capture-priority") {
+            options.core_budget.is_capture_priority_raised = true;
+        } else if (arg == "--sweep-cores") {
+            options.is_core_sweep = true;
+        } else if (arg == "--output" && has_value) {
+            options.output = argv[++i];
+        } else if (arg == "--compare" && i + 2 < argc) {
+            options.compare = std::pair{argv[i + 1], argv[i + 2]};
+            i += 2;
+        } else if (arg == "--tolerance" && has_value) {
+            options.tolerance = std::stod(argv[++i]);
+        } else {
+            std::cerr << "Unknown argument: " << arg << "\n";
+            print_usage(argv[0]);
+            return std::nullopt;
+        }
+    }
+    if (options.frames <= options.warmup + 1) {
+        std::cerr << "--frames has to exceed --warmup by at least two\n";
+        return std::nullopt;
+    }
+    return options;
+}
+
+// Stops the inner source after a number of frames and remembers when each
+// frame was captured so the end-to-end latency can be measured
+class ReplaySource : public vision::FrameSource {
+   public:
+    ReplaySource(vision::FrameSource& source, int frames)
+        : _source(source), _frames(frames) {}
+
+    std::optional<vision::Frames> wait_for_frames() override {
+        if (!_is_exhausted && _delivered < _frames) {
+            try {
+                auto frames = _source.wait_for_frames();
+                if (frames.has_value()) {
+                    std::lock_guard lock{_mutex};
+                    _captured_at[frames->number()] = Clock::now();
+                    ++_delivered;
+                }
+                return frames;
+            } catch (const rs2::error&) {
+                // playback reports the end of a recording with a timeout
+            }
+        }
+        _is_exhausted = true;
+        // the pipeline polls again right away, don't spin on it
+        std::this_thread::sleep_for(std::chrono::milliseconds{1});
+        return std::nullopt;
+    }
+
+    float depth_scale() const override { return _source.depth_scale(); }
+
+    Clock::time_point captured_at(unsigned long long number) {
+        std::lock_guard lock{_mutex};
+        const auto node = _captured_at.extract(number);
+        return node.empty() ? Clock::now() : node.mapped();
+    }
+
+    bool is_exhausted() const { return _is_exhausted; }
+    int delivered() const { return _delivered; }
+
+   private:
+    vision::FrameSource& _source;
+    int _frames;
+
+    std::atomic<bool> _is_exhausted = false;
+    std::atomic<int> _delivered = 0;
+
+    std::mutex _mutex;
+    std::map<unsigned long long, Clock::time_point> _captured_at;
+};
+
+// What the GUI overlay does with ImGui, done on the CPU so it is measurable
+// without a window
+void draw_overlay(const cv::Mat& color,
+                  const std::vector<vision::Detection>& detections) {
+    const auto timer = perf::ScopedTimer{perf::Stage::Overlay};
+
+    auto canvas = color.clone();
+    for (const auto& d : detections) {
+        cv::rectangle(canvas, d.box, cv::Scalar(30, 119, 252), 2);
+        cv::putText(canvas, d.label, d.box.tl(), cv::FONT_HERSHEY_SIMPLEX, 0.5,
+                    cv::Scalar(255, 255, 255));
+    }
+}
+
+double peak_rss_mb() {
+    rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    // kilobytes on Linux
+    return usage.ru_maxrss / 1024.0;
+}
+
+struct Measurement {
+    std::vector<double> latencies_ms;
+    int detections = 0;
+    // frames the pipeline failed to process, warmup included
+    int failed = 0;
+    Clock::time_point tp_first;
+    Clock::time_point tp_last;
+    std::chrono::duration<double> cpu_first{};
+    std::chrono::duration<double> cpu_last{};
+};
+
+// Runs the pipeline over the source once; nullopt when the source ran out
+// before the warmup was over
+std::optional<Measurement> measure(const Options& options,
+                                   vision::Detector& detector,
+                                   const vision::CoreBudget& core_budget) {
+    std::unique_ptr<vision::FrameSource> source;
+    if (options.bag_path.empty()) {
+        source = std::make_unique<vision::SyntheticScene>(
+            vision::SyntheticSceneConfig{.fps = options.fps});
+    } else {
+        auto camera = std::make_unique<vision::Camera>(options.bag_path);
+        camera->set_frame_pool_enabled(options.is_frame_pool_enabled);
+        source = std::move(camera);
+    }
+    auto replay = ReplaySource(*source, options.frames);
+
+    Measurement measurement;
+    std::atomic<int> processed = 0;
+
+    auto pipeline =
+        vision::Pipeline(replay, detector, bench::THRESHOLDS,
+                         {.roi = {.input_size = options.roi_size}});
+    pipeline.set_core_budget(&core_budget);
+    pipeline.set_inference_enabled(true);
+    pipeline.set_tracking_enabled(options.is_tracking_enabled);
+    pipeline.set_roi_enabled(options.is_roi_enabled);
+    if (options.depth_range.has_value()) {
+        pipeline.set_depth_gate_enabled(true);
+        pipeline.set_depth_range(options.depth_range->first,
+                                 options.depth_range->second);
+    }
+    if (options.motion_threshold.has_value()) {
+        pipeline.set_motion_gate_enabled(true);
+        pipeline.set_motion_threshold(*options.motion_threshold);
+    }
+    pipeline.set_callback([&](const vision::Snapshot& snapshot) {
+        draw_overlay(snapshot.frames.color(), snapshot.detections);
+
+        const auto now = Clock::now();
+        const auto captured_at = replay.captured_at(snapshot.frames.number());
+        const auto index = processed.load();
+        if (index == options.warmup) {
+            measurement.tp_first = now;
+            measurement.cpu_first = bench::process_cpu_time();
+        } else if (index > options.warmup) {
+            measurement.latencies_ms.push_back(
+                std::chrono::duration<double, std::milli>(now - captured_at)
+                    .count());
+            measurement.detections += snapshot.detections.size();
+            measurement.tp_last = now;
+            measurement.cpu_last = bench::process_cpu_time();
+        }
+        processed = index + 1;
+    });
+
+    // failed frames never reach the callback, the counter is process wide
+    // and kept over the runs of a sweep
+    const auto failed_before = perf::metrics().get(perf::Counter::Failed);
+    const auto failed = [&] {
+        return static_cast<int>(perf::metrics().get(perf::Counter::Failed) -
+                                failed_before);
+    };
+    pipeline.start();
+    while (!replay.is_exhausted() ||
+           processed + failed() < replay.delivered()) {
+        std::this_thread::sleep_for(std::chrono::milliseconds{10});
+    }
+    pipeline.stop();
+    measurement.failed = failed();
+    if (measurement.failed > 0) {
+        LOG_WARNING << "Failed to process " << measurement.failed
+                    << " frames";
+    }
+
+    if (measurement.latencies_ms.empty()) {
+        LOG_ERROR << "Source ran out after " << processed.load()
+                  << " frames, nothing left to measure after the warmup";
+        return std::nullopt;
+    }
+    return measurement;
+}
+
+double throughput_fps(const Measurement& measurement) {
+    const auto wall = std::chrono::duration<double>(measurement.tp_last -
+                                                    measurement.tp_first);
+    return measurement.latencies_ms.size() / wall.count();
+}
+
+std::vector<int> core_range(int first, int last) {
+    std::vector<int> cores(last - first + 1);
+    std::iota(cores.begin(), cores.end(), first);
+    return cores;
+}
+
+// OpenCV pool sizes in powers of two, unpinned and then with capture on the
+// first core and inference on the others. Pinned budgets go last, OpenCV may
+// keep the pinned workers it started for the rest of the process.
+std::vector<vision::CoreBudgetConfig> sweep_budgets(
+    bool is_capture_priority_raised) {
+    const auto cores = static_cast<int>(
+        std::max(1u, std::thread::hardware_concurrency()));
+
+    std::vector<vision::CoreBudgetConfig> budgets;
+    for (int cv_threads = 1; cv_threads <= cores; cv_threads *= 2) {
+        budgets.push_back({.cv_threads = cv_threads});
+    }
+    if (budgets.back().cv_threads != cores) {
+        budgets.push_back({.cv_threads = cores});
+    }
+    for (int cv_threads = 1; cv_threads < cores; cv_threads *= 2) {
+        budgets.push_back(
+            {.cv_threads = cv_threads,
+             .capture_cores = {0},
+             .inference_cores = core_range(1, cores - 1),
+             .is_capture_priority_raised = is_capture_priority_raised});
+    }
+    return budgets;
+}
+
+int run_sweep(const Options& options, vision::Detector& detector) {
+    struct Row {
+        std::string budget;
+        double fps;
+        double p50_ms;
+        double p99_ms;
+    };
+    std::vector<Row> rows;
+
+    std::printf("%-52s %8s %8s %8s\n", "budget", "fps", "p50 ms", "p99 ms");
+    for (const auto& config :
+         sweep_budgets(options.core_budget.is_capture_priority_raised)) {
+        const auto core_budget = vision::CoreBudget(config);
+        const auto measurement = measure(options, detector, core_budget);
+        if (!measurement.has_value()) {
+            return EXIT_FAILURE;
+        }
+        const auto& row = rows.emplace_back(
+            Row{.budget = core_budget.describe(),
+                .fps = throughput_fps(*measurement),
+                .p50_ms = bench::percentile(measurement->latencies_ms, 0.5),
+                .p99_ms = bench::percentile(measurement->latencies_ms, 0.99)});
+        std::printf("%-52s %8.2f %8.2f %8.2f\n", row.budget.c_str(), row.fps,
+                    row.p50_ms, row.p99_ms);
+    }
+
+    const auto fastest = std::max_element(
+        rows.begin(), rows.end(),
+        [](const Row& a, const Row& b) { return a.fps < b.fps; });
+    const auto steadiest = std::min_element(
+        rows.begin(), rows.end(),
+        [](const Row& a, const Row& b) { return a.p99_ms < b.p99_ms; });
+    std::printf("best throughput: %s, %.2f fps\n", fastest->budget.c_str(),
+                fastest->fps);
+    std::printf("best p99 latency: %s, %.2f ms\n", steadiest->budget.c_str(),
+                steadiest->p99_ms);
+    return EXIT_SUCCESS;
+}
+
+int run_benchmark(const Options& options) {
+    plog::init<plog::TxtFormatter>(plog::info, plog::streamStdErr);
+
+    std::unique_ptr<vision::InferenceEngine> engine;
+    if (!options.tensors_path.empty()) {
+        engine = std::make_unique<vision::ReplayEngine>(options.tensors_path,
+                                                        options.latency);
+    } else {
+        engine = std::make_unique<vision::OpenCVDnnEngine>(options.model_path);
+        if (!options.record_tensors_path.empty()) {
+            engine = std::make_unique<vision::TensorRecorder>(
+                std::move(engine), options.record_tensors_path);
+        }
+    }
+    auto runtime = vision::make_runtime(options.model_type, std::move(engine),
+                                        options.labels_path, 640, 640,
+                                        cv::Scalar(114, 114, 114));
+    runtime.is_input_dynamic = options.is_input_dynamic;
+    auto detector = vision::Detector(std::move(runtime));
+
+    if (options.is_core_sweep) {
+        return run_sweep(options, detector);
+    }
+
+    const auto core_budget = vision::CoreBudget(options.core_budget);
+    const auto measurement = measure(options, detector, core_budget);
+    if (!measurement.has_value()) {
+        return EXIT_FAILURE;
+    }
+    const auto measured = static_cast<int>(measurement->latencies_ms.size());
+    const auto cpu = measurement->cpu_last - measurement->cpu_first;
+    const auto wall = std::chrono::duration<double>(measurement->tp_last -
+                                                    measurement->tp_first);
+
+    const auto flags = cv::FileStorage::WRITE | cv::FileStorage::FORMAT_JSON |
+                       (options.output == "-" ? cv::FileStorage::MEMORY : 0);
+    cv::FileStorage fs(options.output == "-" ? "report.json" : options.output,
+                       flags);
+    fs << "source"
+       << (options.bag_path.empty() ? "synthetic" : options.bag_path);
+    fs << "model" << (options.tensors_path.empty() ? options.model_path
+                                                   : options.tensors_path);
+    fs << "frames" << measured;
+    // over the whole run, warmup included
+    fs << "keyframes"
+       << static_cast<int>(perf::metrics().get(perf::Counter::Keyframes));
+    // model input pixels per processed frame relative to a full frame
+    // through the detector, what --roi and the gates save, warmup included
+    const auto processed = perf::metrics().get(perf::Counter::Processed);
+    fs << "detector" << "{";
+    fs << "roi_frames"
+       << static_cast<int>(perf::metrics().get(perf::Counter::RoiFrames));
+    fs << "input_ratio"
+       << static_cast<double>(
+              perf::metrics().get(perf::Counter::InputPixels)) /
+              (static_cast<double>(processed) * detector.input_size().area());
+    fs << "}";
+    fs << "detections_per_frame"
+       << static_cast<double>(measurement->detections) / measured;
+    fs << "throughput_fps" << throughput_fps(*measurement);
+    fs << "latency_ms" << "{";
+    fs << "mean"
+       << std::accumulate(measurement->latencies_ms.begin(),
+                          measurement->latencies_ms.end(), 0.0) /
+              measured;
+    for (const auto& [name, p] : {std::pair{"p50", 0.5}, std::pair{"p90", 0.9},
+                                  std::pair{"p99", 0.99}}) {
+        fs << name << bench::percentile(measurement->latencies_ms, p);
+    }
+    fs << "max"
+       << *std::max_element(measurement->latencies_ms.begin(),
+                            measurement->latencies_ms.end());
+    fs << "}";
+    fs << "peak_rss_mb" << peak_rss_mb();
+    // 100 is one core fully busy
+    fs << "cpu_percent" << 100.0 * cpu.count() / wall.count();
+    fs << "drops" << "{";
+    fs << "capture"
+       << static_cast<int>(perf::metrics().get(perf::Counter::CaptureDrops));
+    fs << "failed" << measurement->failed;
+    fs << "}";
+
+    // stage durations over the latest samples the metrics keep
+    fs << "stages_ms" << "{";
+    std::array<float, perf::StageTimings::CAPACITY> samples;
+    for (int i = 0; i < static_cast<int>(perf::Stage::MAX); ++i) {
+        const auto stage = static_cast<perf::Stage>(i);
+        const auto n = perf::metrics().timings(stage).copy(samples);
+        if (n == 0) {
+            continue;
+        }
+        const auto values = std::vector<double>(samples.begin(),
+                                                samples.begin() + n);
+        fs << to_cstr(stage) << "{";
+        fs << "p50" << bench::percentile(values, 0.5);
+        fs << "p99" << bench::percentile(values, 0.99);
+        fs << "}";
+    }
+    fs << "}";
+
+    if (options.output == "-") {
+        std::cout << fs.releaseAndGetString();
+    } else {
+        fs.release();
+    }
+    return EXIT_SUCCESS;
+}
+
+struct ComparedMetric {
+    std::vector<const char*> path;
+    bool is_higher_better;
+};
+
+double read_metric(const cv::FileStorage& fs, const ComparedMetric& metric) {
+    auto node = fs[metric.path.front()];
+    for (std::size_t i = 1; i < metric.path.size(); ++i) {
+        node = node[metric.path[i]];
+    }
+    if (node.empty() || (!node.isReal() && !node.isInt())) {
+        throw std::runtime_error{"Report is missing " +
+                                 std::string{metric.path.back()}};
+    }
+    return static_cast<double>(node);
+}
+
+int run_compare(const Options& options) {
+    const auto& [baseline_path, candidate_path] = *options.compare;
+    cv::FileStorage baseline(baseline_path, cv::FileStorage::READ);
+    cv::FileStorage candidate(candidate_path, cv::FileStorage::READ);
+    if (!baseline.isOpened() || !candidate.isOpened()) {
+        std::cerr << "Failed to open the reports\n";
+        return EXIT_FAILURE;
+    }
+
+    const auto metrics = std::vector<ComparedMetric>{
+        {{"throughput_fps"}, true},
+        {{"latency_ms", "p50"}, false},
+        {{"latency_ms", "p90"}, false},
+        {{"latency_ms", "p99"}, false},
+        {{"peak_rss_mb"}, false},
+        {{"cpu_percent"}, false},
+        {{"detector", "input_ratio"}, false},
+    };
+
+    std::printf("%-20s %12s %12s %9s\n", "metric", "baseline", "candidate",
+                "change");
+    int regressions = 0;
+    for (const auto& metric : metrics) {
+        const auto before = read_metric(baseline, metric);
+        const auto after = read_metric(candidate, metric);
+        const auto change = before != 0.0 ? (after - before) / before : 0.0;
+        const auto is_regression = metric.is_higher_better
+                                       ? change < -options.tolerance
+                                       : change > options.tolerance;
+        regressions += is_regression;
+
+        auto name = std::string{metric.path.front()};
+        for (std::size_t i = 1; i < metric.path.size(); ++i) {
+            name += std::string{"."} + metric.path[i];
+        }
+        std::printf("%-20s %12.2f %12.2f %+8.1f%%%s\n", name.c_str(), before,
+                    after, 100.0 * change,
+                    is_regression ? "  REGRESSION" : "");
+    }
+
+    std::printf("%d regression(s) at %.1f%% tolerance\n", regressions,
+                100.0 * options.tolerance);
+    return regressions == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    const auto options = parse_options(argc, argv);
+    if (!options.has_value()) {
+        return EXIT_FAILURE;
+    }
+
+    try {
+        return options->compare.has_value() ? run_compare(*options)
+                                            : run_benchmark(*options);
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << "\n";
+        return EXIT_FAILURE;
+    }
+}
@@ -0,0 +1,327 @@
+// Scaling of capture, detection and depth stats to many streams on one box:
+// runs N synthetic scenes at once, each through its own Pipeline and
+// Detector like N cameras would, and prints a row per stream count with the
+// total and slowest stream's throughput, the latency from rendering to the
+// processed snapshot and the CPU used.
+//
+// The scenes' default objects are textured shapes no COCO model recognizes,
+// so those runs only measure throughput, latency and CPU. Detections are
+// checked against the ground truth when pictures of real objects are given
+// with --sprite, which the scenes draw as their objects: the share of
+// objects found at an IoU of 0.5 or more and how far the measured distance
+// of those is off.
+//
+//   bench_scaling [--streams <counts>] [--size WxH] [--fps F] [--objects N]
+//                 [--sprite <image>]... [--warmup S] [--seconds S]
+//                 [--model <onnx>] [--labels <names>] [--type yolov5|yolov8]
+//                 [--tensors <path> [--latency MS]]
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include <plog/Formatters/TxtFormatter.h>
+#include <plog/Initializers/ConsoleInitializer.h>
+#include <plog/Log.h>
+#include <opencv2/opencv.hpp>
+
+#include "bench/harness.h"
+#include "vision/detector.h"
+#include "vision/engines/opencv_dnn.h"
+#include "vision/engines/replay.h"
+#include "vision/factory.h"
+#include "vision/pipeline.h"
+#include "vision/synthetic_scene.h"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+// a detection this close to an object counts as finding it
+constexpr float MATCH_IOU = 0.5f;
+
+struct Options {
+    std::vector<int> streams = {1, 2, 4};
+    int width = 1280;
+    int height = 720;
+    // per stream, 0 renders as fast as each pipeline consumes
+    float fps = 30.f;
+    int objects = 4;
+    // BGR, drawn as the objects when set
+    std::vector<cv::Mat> sprites;
+    std::chrono::duration<double> warmup{2.0};
+    std::chrono::duration<double> duration{10.0};
+    std::string model_path = "yolov12n.onnx";
+    std::string labels_path = "coco.names";
+    vision::ModelType model_type = vision::ModelType::YOLOv8;
+    // recorded output tensors replace the model when set
+    std::string tensors_path;
+    std::chrono::microseconds latency{0};
+};
+
+void print_usage(const char* name) {
+    std::cerr << "Usage: " << name
+              << " [--streams <counts>] [--size WxH] [--fps F]"
+                 " [--objects N]\n"
+                 "       [--sprite <image>]... [--warmup S] [--seconds S]\n"
+                 "       [--model <onnx>] [--labels <names>]"
+                 " [--type yolov5|yolov8]\n"
+                 "       [--tensors <path> [--latency MS]]\n";
+}
+
+// "1,2,4,8"
+std::vector<int> parse_counts(std::string_view text) {
+    std::vector<int> counts;
+    while (!text.empty()) {
+        const auto comma = text.find(',');
+        const auto count = std::stoi(std::string{text.substr(0, comma)});
+        if (count <= 0) {
+            throw std::invalid_argument{"Stream counts have to be positive"};
+        }
+        counts.push_back(count);
+        text = comma == std::string_view::npos ? std::string_view{}
+                                               : text.substr(comma + 1);
+    }
+    return counts;
+}
+
+std::optional<Options> parse_options(int argc, char** argv) {
+    Options options;
+    for (int i = 1; i < argc; ++i) {
+        const auto arg = std::string_view{argv[i]};
+        const auto has_value = i + 1 < argc;
+        if (arg == "--streams" && has_value) {
+            options.streams = parse_counts(argv[++i]);
+        } else if (arg == "--size" && has_value) {
+            const auto size = std::string_view{argv[++i]};
+            const auto x = size.find('x');
+            if (x == std::string_view::npos) {
+                std::cerr << "Size has to be WxH: " << size << "\n";
+                return std::nullopt;
+            }
+            options.width = std::stoi(std::string{size.substr(0, x)});
+            options.height = std::stoi(std::string{size.substr(x + 1)});
+        } else if (arg == "--fps" && has_value) {
+            options.fps = std::stof(argv[++i]);
+        } else if (arg == "--objects" && has_value) {
+            options.objects = std::stoi(argv[++i]);
+        } else if (arg == "--sprite" && has_value) {
+            const auto path = std::string{argv[++i]};
+            auto sprite = cv::imread(path, cv::IMREAD_COLOR);
+            if (sprite.empty()) {
+                std::cerr << "Failed to read sprite: " << path << "\n";
+                return std::nullopt;
+            }
+            options.sprites.push_back(std::move(sprite));
+        } else if (arg == "--warmup" && has_value) {
+            options.warmup =
+                std::chrono::duration<double>(std::stod(argv[++i]));
+        } else if (arg == "--seconds" && has_value) {
+            options.duration =
+                std::chrono::duration<double>(std::stod(argv[++i]));
+        } else if (arg == "--model" && has_value) {
+            options.model_path = argv[++i];
+        } else if (arg == "--labels" && has_value) {
+            options.labels_path = argv[++i];
+        } else if (arg == "--type" && has_value) {
+            const auto type = bench::parse_model_type(argv[++i]);
+            if (!type.has_value()) {
+                return std::nullopt;
+            }
+            options.model_type = *type;
+        } else if (arg == "--tensors" && has_value) {
+            options.tensors_path = argv[++i];
+        } else if (arg == "--latency" && has_value) {
+            options.latency = std::chrono::microseconds{
+                static_cast<long>(std::stod(argv[++i]) * 1000.0)};
+        } else {
+            std::cerr << "Unknown argument: " << arg << "\n";
+            print_usage(argv[0]);
+            return std::nullopt;
+        }
+    }
+    if (options.streams.empty() || options.duration.count() <= 0.0) {
+        print_usage(argv[0]);
+        return std::nullopt;
+    }
+    return options;
+}
+
+float iou(const cv::Rect& a, const cv::Rect& b) {
+    const auto intersection = (a & b).area();
+    const auto united = a.area() + b.area() - intersection;
+    return united > 0 ? static_cast<float>(intersection) / united : 0.f;
+}
+
+vision::Detector make_detector(const Options& options) {
+    std::unique_ptr<vision::InferenceEngine> engine;
+    if (!options.tensors_path.empty()) {
+        engine = std::make_unique<vision::ReplayEngine>(options.tensors_path,
+                                                        options.latency);
+    } else {
+        engine = std::make_unique<vision::OpenCVDnnEngine>(options.model_path);
+    }
+    return vision::Detector(vision::make_runtime(
+        options.model_type, std::move(engine), options.labels_path, 640, 640,
+        cv::Scalar(114, 114, 114)));
+}
+
+// One simulated camera and everything processing it. The statistics are
+// only touched by the pipeline's worker thread until it is stopped.
+struct Stream {
+    Stream(const Options& options, unsigned int seed,
+           const std::atomic<bool>& is_measuring)
+        : scene(vision::SyntheticSceneConfig{.width = options.width,
+                                             .height = options.height,
+                                             .fps = options.fps,
+                                             .objects_num = options.objects,
+                                             .seed = seed,
+                                             .sprites = options.sprites}),
+          detector(make_detector(options)),
+          pipeline(scene, detector, bench::THRESHOLDS) {
+        pipeline.set_inference_enabled(true);
+        pipeline.set_callback([this, &is_measuring](const auto& snapshot) {
+            if (is_measuring) {
+                record(snapshot);
+            }
+        });
+    }
+
+    void record(const vision::Snapshot& snapshot) {
+        const auto now = std::chrono::duration<double, std::milli>(
+            Clock::now().time_since_epoch());
+        latencies_ms.push_back(now.count() - snapshot.frames.timestamp());
+
+        for (const auto& object :
+             scene.objects_at(snapshot.frames.number())) {
+            ++objects;
+            const auto found = std::find_if(
+                snapshot.detections.begin(), snapshot.detections.end(),
+                [&](const vision::Detection& d) {
+                    return iou(d.box, object.box) >= MATCH_IOU;
+                });
+            if (found == snapshot.detections.end()) {
+                continue;
+            }
+            ++matched;
+            if (!std::isnan(found->distance)) {
+                ++measured;
+                distance_error_m += std::abs(found->distance - object.distance);
+            }
+        }
+    }
+
+    vision::SyntheticScene scene;
+    vision::Detector detector;
+    vision::Pipeline pipeline;
+
+    std::vector<double> latencies_ms;
+    std::size_t objects = 0;
+    std::size_t matched = 0;
+    // matched detections with a distance
+    std::size_t measured = 0;
+    double distance_error_m = 0.0;
+};
+
+void run_streams(const Options& options, int streams_num) {
+    std::atomic<bool> is_measuring = false;
+    std::vector<std::unique_ptr<Stream>> streams;
+    for (int i = 0; i < streams_num; ++i) {
+        // every camera sees a different scene
+        streams.push_back(
+            std::make_unique<Stream>(options, 0x5eed + i, is_measuring));
+    }
+
+    for (auto& stream : streams) {
+        stream->pipeline.start();
+    }
+    std::this_thread::sleep_for(options.warmup);
+
+    const auto cpu_before = bench::process_cpu_time();
+    const auto tp_before = Clock::now();
+    is_measuring = true;
+    std::this_thread::sleep_for(options.duration);
+    is_measuring = false;
+    const auto wall = std::chrono::duration<double>(Clock::now() - tp_before);
+    const auto cpu = bench::process_cpu_time() - cpu_before;
+
+    for (auto& stream : streams) {
+        stream->pipeline.stop();
+    }
+
+    std::vector<double> latencies_ms;
+    std::size_t frames_min = std::numeric_limits<std::size_t>::max();
+    std::size_t frames = 0;
+    std::size_t objects = 0;
+    std::size_t matched = 0;
+    std::size_t measured = 0;
+    double distance_error_m = 0.0;
+    for (const auto& stream : streams) {
+        latencies_ms.insert(latencies_ms.end(), stream->latencies_ms.begin(),
+                            stream->latencies_ms.end());
+        frames += stream->latencies_ms.size();
+        frames_min = std::min(frames_min, stream->latencies_ms.size());
+        objects += stream->objects;
+        matched += stream->matched;
+        measured += stream->measured;
+        distance_error_m += stream->distance_error_m;
+    }
+
+    // shapes aren't expected to be found
+    const auto is_checked = !options.sprites.empty();
+    const auto found = is_checked && objects > 0
+                           ? cv::format("%.1f", 100.0 * matched / objects)
+                           : std::string{"-"};
+    const auto error = is_checked && measured > 0
+                           ? cv::format("%.3f", distance_error_m / measured)
+                           : std::string{"-"};
+    std::printf("%7d %10.2f %10.2f %8.2f %8.2f %8.1f %8s %10s\n",
+                streams_num, frames / wall.count(),
+                frames_min / wall.count(), bench::percentile(latencies_ms, 0.5),
+                bench::percentile(latencies_ms, 0.99),
+                100.0 * cpu.count() / wall.count(), found.c_str(),
+                error.c_str());
+    std::fflush(stdout);
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    const auto options = parse_options(argc, argv);
+    if (!options.has_value()) {
+        return EXIT_FAILURE;
+    }
+
+    try {
+        plog::init<plog::TxtFormatter>(plog::info, plog::streamStdErr);
+
+        const auto pace = options->fps > 0.f
+                              ? cv::format("%.1f fps", options->fps)
+                              : std::string{"unpaced"};
+        std::printf("%dx%d at %s per stream, %d %s each\n", options->width,
+                    options->height, pace.c_str(), options->objects,
+                    options->sprites.empty() ? "shapes" : "sprites");
+        // fps: all streams and the slowest one; cpu: 100 is one core;
+        // found: share of sprites detected; error: distance of those
+        std::printf("%7s %10s %10s %8s %8s %8s %8s %10s\n", "streams",
+                    "fps", "fps min", "p50 ms", "p99 ms", "cpu %", "found %",
+                    "error m");
+        for (const auto streams_num : options->streams) {
+            run_streams(*options, streams_num);
+        }
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << "\n";
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
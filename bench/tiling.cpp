@@ -0,0 +1,152 @@
+// Throughput of tiled inference on a synthetic 848x480 frame for a range of
+// tile sizes and detector pool sizes. OpenCV's own threads are split evenly
+// between the pool so the runs don't oversubscribe the cores, which makes
+// the speedup over a pool of one the scaling with cores. What the tiles buy
+// is shown next to it: the scale objects have at the model input and the
+// gain over letterboxing the whole frame, e.g. the pixels a 16 px object
+// spans for the model.
+//
+//   bench_tiling [--model <onnx>] [--labels <names>] [--type yolov5|yolov8]
+//                [--tile-sizes 640,480,416,320] [--max-pool N]
+
+#include <algorithm>
+#include <cstdio>
+#include <iostream>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include <opencv2/opencv.hpp>
+
+#include "bench/harness.h"
+#include "vision/detail/crops.h"
+#include "vision/factory.h"
+#include "vision/tiled_detector.h"
+
+namespace {
+
+constexpr int FRAME_W = 848;
+constexpr int FRAME_H = 480;
+constexpr int INPUT_SIZE = 640;
+
+struct Options {
+    std::string model_path = "yolov12n.onnx";
+    std::string labels_path = "coco.names";
+    vision::ModelType model_type = vision::ModelType::YOLOv8;
+    std::vector<int> tile_sizes = {640, 480, 416, 320};
+    int max_pool = static_cast<int>(
+        std::max(1u, std::thread::hardware_concurrency()));
+};
+
+std::optional<Options> parse_options(int argc, char** argv) {
+    Options options;
+    for (int i = 1; i < argc; ++i) {
+        const auto arg = std::string_view{argv[i]};
+        const auto has_value = i + 1 < argc;
+        if (arg == "--model" && has_value) {
+            options.model_path = argv[++i];
+        } else if (arg == "--labels" && has_value) {
+            options.labels_path = argv[++i];
+        } else if (arg == "--type" && has_value) {
+            const auto type = bench::parse_model_type(argv[++i]);
+            if (!type.has_value()) {
+                return std::nullopt;
+            }
+            options.model_type = *type;
+        } else if (arg == "--tile-sizes" && has_value) {
+            options.tile_sizes.clear();
+            auto list = std::istringstream{argv[++i]};
+            for (std::string size; std::getline(list, size, ',');) {
+                const auto tile_size = std::stoi(size);
+                // would plan empty tiles, input_scale() divides by them
+                if (tile_size <= 0) {
+                    std::cerr << "Tile sizes must be positive: " << size
+                              << "\n";
+                    return std::nullopt;
+                }
+                options.tile_sizes.push_back(tile_size);
+            }
+        } else if (arg == "--max-pool" && has_value) {
+            options.max_pool = std::stoi(argv[++i]);
+        } else {
+            std::cerr << "Unknown argument: " << arg << "\n"
+                      << "Usage: " << argv[0]
+                      << " [--model <onnx>] [--labels <names>]"
+                         " [--type yolov5|yolov8]\n"
+                         "       [--tile-sizes 640,480,416,320]"
+                         " [--max-pool N]\n";
+            return std::nullopt;
+        }
+    }
+    return options;
+}
+
+// model input pixels per frame pixel of a crop letterboxed to the input
+float input_scale(cv::Size crop) {
+    return std::min(static_cast<float>(INPUT_SIZE) / crop.width,
+                    static_cast<float>(INPUT_SIZE) / crop.height);
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    const auto options = parse_options(argc, argv);
+    if (!options.has_value()) {
+        return EXIT_FAILURE;
+    }
+
+    cv::RNG rng(0x5eed);
+    cv::Mat frame(FRAME_H, FRAME_W, CV_8UC3);
+    rng.fill(frame, cv::RNG::UNIFORM, 0, 256);
+
+    const auto cores = static_cast<int>(
+        std::max(1u, std::thread::hardware_concurrency()));
+
+    // scale: of objects at the model input; gain: over the whole frame;
+    // 16 px: what an object of 16 frame pixels spans at the model input
+    const auto frame_scale = input_scale(frame.size());
+    std::printf("%9s %6s %6s %6s %6s %5s %10s %10s %8s\n", "tile size",
+                "tiles", "scale", "gain", "16 px", "pool", "cv threads", "fps",
+                "scaling");
+    for (const auto tile_size : options->tile_sizes) {
+        const auto tiles = plan_tiles(frame.size(), tile_size,
+                                      vision::TilingConfig{}.overlap);
+        const auto tiles_num = tiles.size();
+        const auto scale = input_scale(tiles.front().size());
+
+        double single_fps = 0.0;
+        for (int pool_size = 1; pool_size <= options->max_pool;
+             pool_size *= 2) {
+            std::vector<vision::Detector> pool;
+            for (int i = 0; i < pool_size; ++i) {
+                pool.emplace_back(vision::make_runtime(
+                    options->model_type, options->model_path,
+                    options->labels_path, INPUT_SIZE, INPUT_SIZE,
+                    cv::Scalar(114, 114, 114)));
+            }
+            auto detector = vision::TiledDetector(
+                std::move(pool), vision::TilingConfig{.tile_size = tile_size});
+
+            const auto cv_threads = std::max(1, cores / pool_size);
+            cv::setNumThreads(cv_threads);
+
+            const auto result = bench::run("tiled", [&] {
+                bench::do_not_optimize(
+                    detector.detect(frame, bench::THRESHOLDS));
+            });
+            const auto fps = 1e9 / result.ns_per_op;
+            if (pool_size == 1) {
+                single_fps = fps;
+            }
+            std::printf(
+                "%9d %6zu %5.2fx %5.2fx %6.1f %5d %10d %10.2f %7.2fx\n",
+                tile_size, tiles_num, scale, scale / frame_scale, 16.f * scale,
+                pool_size, cv_threads, fps, fps / single_fps);
+        }
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -1,5 +1,12 @@
 #include "application.h"
 
+#include <algorithm>
+#include <cfloat>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
 #include <GLFW/glfw3.h>
 #include <imgui.h>
 #include <imgui_impl_glfw.h>
@@ -7,6 +14,8 @@
 #include <imgui_stdlib.h>
 #include <plog/Log.h>
 
+#include "perf/metrics.h"
+
 namespace {
 
 static void glfw_error_callback(int error, const char* description) {
@@ -26,19 +35,44 @@ struct GlProgramError : std::runtime_error {
     using std::runtime_error::runtime_error;
 };
 
+// Draws a full screen quad, used to render raw stream textures into the
+// displayed RGBA texture
 const char* vert_shader_src =
     "#version 330 core\n"
-    "layout (location = 0) in vec3 aPos;\n"
+    "layout (location = 0) in vec2 aPos;\n"
+    "uniform vec2 uv_scale;\n"
+    "out vec2 uv;\n"
     "void main()\n"
     "{\n"
-    "   gl_Position = vec4(aPos.x, aPos.y, aPos.z, 1.0);\n"
+    "   uv = (aPos * 0.5 + 0.5) * uv_scale;\n"
+    "   gl_Position = vec4(aPos.x, aPos.y, 0.0, 1.0);\n"
     "}\0";
+// mode 0 colorizes Z16 depth (stored normalized in a R16 texture) with the
+// palette lookup texture, mode 1 expands a single channel to grayscale
 const char* frag_shader_src =
     "#version 330 core\n"
+    "in vec2 uv;\n"
     "out vec4 FragColor;\n"
+    "uniform sampler2D source;\n"
+    "uniform sampler2D palette;\n"
+    "uniform int mode;\n"
+    "uniform float depth_units;\n"
+    "uniform vec2 depth_range;\n"
     "void main()\n"
     "{\n"
-    "   FragColor = vec4(1.0f, 0.5f, 0.2f, 1.0f);\n"
+    "   float value = texture(source, uv).r;\n"
+    "   if (mode == 1) {\n"
+    "       FragColor = vec4(value, value, value, 1.0f);\n"
+    "       return;\n"
+    "   }\n"
+    "   float depth = value * depth_units;\n"
+    "   if (depth <= 0.0) {\n"
+    "       FragColor = vec4(0.0f, 0.0f, 0.0f, 1.0f);\n"
+    "       return;\n"
+    "   }\n"
+    "   float span = max(depth_range.y - depth_range.x, 0.001);\n"
+    "   float t = clamp((depth - depth_range.x) / span, 0.0, 1.0);\n"
+    "   FragColor = vec4(texture(palette, vec2(t, 0.5)).rgb, 1.0f);\n"
     "}\n\0";
 
 unsigned compile_vert_shader() {
@@ -93,10 +127,68 @@ unsigned link_shader_program(unsigned vert_shader, unsigned frag_shader) {
     return program;
 }
 
-void build_shader_program() {
+unsigned build_shader_program() {
     const auto vert_shader = compile_vert_shader();
     const auto frag_shader = compile_frag_shader();
-    link_shader_program(vert_shader, frag_shader);
+    return link_shader_program(vert_shader, frag_shader);
+}
+
+// Jet palette, near is blue and far is red, same as the rs2::colorizer
+// default
+GLuint create_palette_texture() {
+    constexpr int size = 256;
+    std::array<unsigned char, size * 3> palette;
+    const auto channel = [](float t, float center) {
+        const auto v = std::clamp(1.5f - std::abs(4.f * t - center), 0.f, 1.f);
+        return static_cast<unsigned char>(v * 255.f);
+    };
+    for (int i = 0; i < size; ++i) {
+        const auto t = static_cast<float>(i) / (size - 1);
+        palette[i * 3 + 0] = channel(t, 3.f);
+        palette[i * 3 + 1] = channel(t, 2.f);
+        palette[i * 3 + 2] = channel(t, 1.f);
+    }
+
+    GLuint texture;
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB8, size, 1, 0, GL_RGB,
+                 GL_UNSIGNED_BYTE, palette.data());
+    glBindTexture(GL_TEXTURE_2D, 0);
+    return texture;
+}
+
+gui::Application::DisplayPass create_display_pass() {
+    gui::Application::DisplayPass pass;
+    pass.program = build_shader_program();
+    pass.source_location = glGetUniformLocation(pass.program, "source");
+    pass.palette_location = glGetUniformLocation(pass.program, "palette");
+    pass.mode_location = glGetUniformLocation(pass.program, "mode");
+    pass.depth_units_location =
+        glGetUniformLocation(pass.program, "depth_units");
+    pass.depth_range_location =
+        glGetUniformLocation(pass.program, "depth_range");
+    pass.uv_scale_location = glGetUniformLocation(pass.program, "uv_scale");
+
+    const float quad[] = {-1.f, -1.f, 1.f, -1.f, -1.f, 1.f, 1.f, 1.f};
+    glGenVertexArrays(1, &pass.vertex_array);
+    glGenBuffers(1, &pass.vertex_buffer);
+    glBindVertexArray(pass.vertex_array);
+    glBindBuffer(GL_ARRAY_BUFFER, pass.vertex_buffer);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(quad), quad, GL_STATIC_DRAW);
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float),
+                          nullptr);
+    glEnableVertexAttribArray(0);
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    pass.palette = create_palette_texture();
+    return pass;
 }
 
 void init_glfw() {
@@ -220,24 +312,169 @@ void init_imgui(GLFWwindow* window) {
     }
 }
 
-GLuint create_texture(int width, int height) {
+GLuint create_texture(int width, int height, GLint internal_format = GL_RGBA8,
+                      GLenum format = GL_RGB, GLenum type = GL_UNSIGNED_BYTE,
+                      GLint filter = GL_LINEAR) {
     GLuint texture;
 
     glGenTextures(1, &texture);
     glBindTexture(GL_TEXTURE_2D, texture);
 
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, filter);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, filter);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
 
     glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_RGB,
-                 GL_UNSIGNED_BYTE, nullptr);
+    glTexImage2D(GL_TEXTURE_2D, 0, internal_format, width, height, 0, format,
+                 type, nullptr);
     glBindTexture(GL_TEXTURE_2D, 0);
     return texture;
 }
 
+GLuint create_framebuffer(GLuint texture) {
+    GLuint framebuffer;
+    glGenFramebuffers(1, &framebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D,
+                           texture, 0);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        LOG_ERROR << "Video stream framebuffer is incomplete";
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    return framebuffer;
+}
+
+// Persistently mapped buffers need glBufferStorage, core in OpenGL 4.4 and
+// available on older contexts through ARB_buffer_storage. glad loads both
+// into the same function pointer.
+bool has_buffer_storage() {
+#if defined(GL_VERSION_4_4) || defined(GL_ARB_buffer_storage)
+    auto is_supported = false;
+#ifdef GL_VERSION_4_4
+    is_supported = is_supported || GLAD_GL_VERSION_4_4;
+#endif
+#ifdef GL_ARB_buffer_storage
+    is_supported = is_supported || GLAD_GL_ARB_buffer_storage;
+#endif
+    return is_supported && glBufferStorage != nullptr;
+#else
+    return false;
+#endif
+}
+
+void create_pixel_buffer(gui::Application::PixelBuffer& pixel_buffer,
+                         std::size_t size) {
+    glGenBuffers(1, &pixel_buffer.buffer);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pixel_buffer.buffer);
+
+#if defined(GL_VERSION_4_4) || defined(GL_ARB_buffer_storage)
+    if (has_buffer_storage()) {
+        const GLbitfield flags =
+            GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        glBufferStorage(GL_PIXEL_UNPACK_BUFFER, size, nullptr, flags);
+        pixel_buffer.mapped =
+            glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, size, flags);
+    }
+#endif
+    if (pixel_buffer.mapped == nullptr) {
+        glBufferData(GL_PIXEL_UNPACK_BUFFER, size, nullptr, GL_STREAM_DRAW);
+    }
+
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+}
+
+void destroy_pixel_buffer(gui::Application::PixelBuffer& pixel_buffer) {
+    if (pixel_buffer.fence != nullptr) {
+        glDeleteSync(pixel_buffer.fence);
+    }
+    if (pixel_buffer.mapped != nullptr) {
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pixel_buffer.buffer);
+        glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    }
+    glDeleteBuffers(1, &pixel_buffer.buffer);
+    pixel_buffer = {};
+}
+
+// Returns memory to write the next frame to. The texture update is then
+// issued from the buffer object instead of client memory, so the driver can
+// return immediately and perform the transfer while the previous frame is
+// still being drawn.
+void* map_pixel_buffer(gui::Application::PixelBuffer& pixel_buffer,
+                       std::size_t size) {
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pixel_buffer.buffer);
+
+    if (pixel_buffer.mapped != nullptr) {
+        if (pixel_buffer.fence != nullptr) {
+            // by the time the ring wraps around the fence has normally
+            // signaled already, so this doesn't block
+            glClientWaitSync(pixel_buffer.fence, GL_SYNC_FLUSH_COMMANDS_BIT,
+                             GLuint64{1'000'000'000});
+            glDeleteSync(pixel_buffer.fence);
+            pixel_buffer.fence = nullptr;
+        }
+        return pixel_buffer.mapped;
+    }
+
+    // orphan the storage so the driver hands out fresh memory instead of
+    // waiting until the pending upload from this buffer is done
+    glBufferData(GL_PIXEL_UNPACK_BUFFER, size, nullptr, GL_STREAM_DRAW);
+    return glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, size,
+                            GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT |
+                                GL_MAP_UNSYNCHRONIZED_BIT);
+}
+
+void unmap_pixel_buffer(const gui::Application::PixelBuffer& pixel_buffer) {
+    if (pixel_buffer.mapped == nullptr) {
+        glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+    }
+}
+
+std::size_t bytes_per_pixel(gui::Application::Stream stream) {
+    switch (stream) {
+        case gui::Application::Stream::Color:
+            return 3;
+        case gui::Application::Stream::Depth:
+            return 2;
+        default:
+            return 1;
+    }
+}
+
+int downsampled_size(int size, int downsample) {
+    return (size + downsample - 1) / downsample;
+}
+
+// Copies a tightly packed image, keeping only every n-th row and column
+// when downsampling
+void copy_image(unsigned char* dst, const unsigned char* src, int width,
+                int height, std::size_t bytes_per_pixel, int downsample) {
+    const auto row_size = static_cast<std::size_t>(width) * bytes_per_pixel;
+    if (downsample == 1) {
+        std::memcpy(dst, src, row_size * height);
+        return;
+    }
+
+    const auto step = bytes_per_pixel * downsample;
+    for (int y = 0; y < height; y += downsample) {
+        const auto* src_px = src + row_size * y;
+        const auto* const src_end = src_px + row_size;
+        for (; src_px < src_end; src_px += step, dst += bytes_per_pixel) {
+            std::memcpy(dst, src_px, bytes_per_pixel);
+        }
+    }
+}
+
+// Partially sorts the samples, n is expected to be non-zero
+float percentile(std::array<float, perf::StageTimings::CAPACITY>& samples,
+                 std::size_t n, float p) {
+    const auto k = std::min(
+        n - 1, static_cast<std::size_t>(p * static_cast<float>(n - 1) + 0.5f));
+    std::nth_element(samples.begin(), samples.begin() + k, samples.begin() + n);
+    return samples[k];
+}
+
 }  // namespace
 
 namespace gui {
@@ -247,11 +484,22 @@ Application::~Application() {
     ImGui_ImplGlfw_Shutdown();
     ImGui::DestroyContext();
 
-    // optional: de-allocate all resources once they've outlived their
-    // purpose
-    // glDeleteVertexArrays(1, &VAO);
-    // glDeleteBuffers(1, &VBO);
-    // glDeleteProgram(shaderProgram);
+    if (_video_stream.has_value()) {
+        for (auto& texture : _video_stream->textures) {
+            for (auto& pixel_buffer : texture.pixel_buffers) {
+                destroy_pixel_buffer(pixel_buffer);
+            }
+            glDeleteFramebuffers(1, &texture.framebuffer);
+            glDeleteTextures(1, &texture.texture);
+            glDeleteTextures(1, &texture.raw_texture);
+        }
+    }
+    if (_display_pass.has_value()) {
+        glDeleteVertexArrays(1, &_display_pass->vertex_array);
+        glDeleteBuffers(1, &_display_pass->vertex_buffer);
+        glDeleteTextures(1, &_display_pass->palette);
+        glDeleteProgram(_display_pass->program);
+    }
 
     if (_window.has_value()) {
         glfwDestroyWindow(_window->window);
@@ -274,7 +522,7 @@ bool Application::init(int width, int height, std::string title) {
         init_imgui(_window->window);
         LOG_INFO << "Dear ImGui initialized";
 
-        build_shader_program();
+        _display_pass = create_display_pass();
         LOG_INFO << "GlProgram initialized";
     } catch (InitError e) {
         LOG_ERROR << "Initialization failed:";
@@ -287,48 +535,92 @@ bool Application::init(int width, int height, std::string title) {
     return true;
 }
 
-void Application::create_video_stream(int width, int height) {
-    _video_stream = VideoStream{.width = width,
-                                .height = height,
-                                .texture = create_texture(width, height)};
+void Application::create_video_stream(int width, int height,
+                                      float depth_scale) {
+    _video_stream = VideoStream{
+        .width = width, .height = height, .depth_scale = depth_scale};
+
+    for (auto& texture : _video_stream->textures) {
+        texture.texture = create_texture(width, height);
+    }
+
+    auto& depth = _video_stream->textures[static_cast<int>(Stream::Depth)];
+    depth.raw_texture = create_texture(width, height, GL_R16, GL_RED,
+                                       GL_UNSIGNED_SHORT, GL_NEAREST);
+    depth.framebuffer = create_framebuffer(depth.texture);
+
+    auto& ir = _video_stream->textures[static_cast<int>(Stream::IR)];
+    ir.raw_texture = create_texture(width, height, GL_R8, GL_RED,
+                                    GL_UNSIGNED_BYTE, GL_NEAREST);
+    ir.framebuffer = create_framebuffer(ir.texture);
+
+    for (int i = 0; i < static_cast<int>(Stream::MAX); ++i) {
+        auto& texture = _video_stream->textures[i];
+        texture.pixel_buffer_size = static_cast<std::size_t>(width) *
+                                    static_cast<std::size_t>(height) *
+                                    bytes_per_pixel(static_cast<Stream>(i));
+        for (auto& pixel_buffer : texture.pixel_buffers) {
+            create_pixel_buffer(pixel_buffer, texture.pixel_buffer_size);
+        }
+    }
+
+    LOG_INFO << "Video stream uses "
+             << (_video_stream->textures[0].pixel_buffers[0].mapped != nullptr
+                     ? "persistently mapped"
+                     : "orphaned")
+             << " pixel buffers";
+}
+
+void Application::update_video_stream(const unsigned char* color_bgr,
+                                      const unsigned short* depth_z16,
+                                      const unsigned char* ir_y8,
+                                      unsigned long long frame_id) {
+    assert(_video_stream.has_value());
+
+    if (!perf::metrics().is_enabled(perf::Stage::Upload)) {
+        return;
+    }
+
+    upload_stream(Stream::Color, color_bgr, frame_id);
+    upload_stream(Stream::Depth, depth_z16, frame_id);
+    upload_stream(Stream::IR, ir_y8, frame_id);
 }
 
-void Application::update_video_stream(unsigned char* color_bgr,
-                                      unsigned char* depth_rgb,
-                                      unsigned char* ir_y8) const {
-    glBindTexture(GL_TEXTURE_2D, _video_stream->texture);
-    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+void Application::upload_stream(Stream stream, const void* data,
+                                unsigned long long frame_id) {
+    auto& video_stream = _video_stream.value();
+    auto& texture = video_stream.textures[static_cast<int>(stream)];
+
+    const auto frame = std::make_pair(frame_id, texture.downsample);
+    if (!texture.is_visible || texture.uploaded_frame == frame) {
+        ++texture.upload_stats.skipped;
+        return;
+    }
 
-    unsigned char* current_data;
-    GLenum current_format;
+    if (data == nullptr) {
+        LOG_ERROR << "No " << enum_stream_to_cstr(stream)
+                  << " data provided to upload";
+        return;
+    }
+
+    unsigned target = texture.texture;
+    GLenum format = GL_BGR;
+    GLenum type = GL_UNSIGNED_BYTE;
+    int display_mode = -1;
 
-    switch (_current_stream) {
+    switch (stream) {
         case Stream::Color:
-            if (color_bgr == nullptr) {
-                LOG_ERROR
-                    << "No color BGR data provided (passing nullptr to the "
-                       "glTexSubImage2D)";
-            }
-            current_data = color_bgr;
-            current_format = GL_BGR;
             break;
         case Stream::Depth:
-            if (color_bgr == nullptr) {
-                LOG_ERROR
-                    << "No depth RGB data provided (passing nullptr to the "
-                       "glTexSubImage2D)";
-            }
-            current_data = depth_rgb;
-            current_format = GL_RGB;
+            target = texture.raw_texture;
+            format = GL_RED;
+            type = GL_UNSIGNED_SHORT;
+            display_mode = 0;
             break;
         case Stream::IR:
-            if (color_bgr == nullptr) {
-                LOG_ERROR << "No infrared grayscale data provided (passing "
-                             "nullptr to the "
-                             "glTexSubImage2D)";
-            }
-            current_data = ir_y8;
-            current_format = GL_RGB;
+            target = texture.raw_texture;
+            format = GL_RED;
+            display_mode = 1;
             break;
         case Stream::MAX:
             assert(false && "Invalid enum value Application::Stream::MAX used");
@@ -336,13 +628,57 @@ void Application::update_video_stream(unsigned char* color_bgr,
             assert(false && "Unknown enum value of Application::Stream");
     }
 
+    const auto tp_before = std::chrono::steady_clock::now();
+
+    const auto width = downsampled_size(video_stream.width, texture.downsample);
+    const auto height =
+        downsampled_size(video_stream.height, texture.downsample);
+
+    // the buffer this stream uploaded from PIXEL_BUFFERS_NUM frames ago
+    auto& pixel_buffer = texture.pixel_buffers[texture.pixel_buffer_index];
+    texture.pixel_buffer_index =
+        (texture.pixel_buffer_index + 1) % texture.pixel_buffers.size();
+
+    auto* dst = map_pixel_buffer(pixel_buffer, texture.pixel_buffer_size);
+    if (dst == nullptr) {
+        LOG_ERROR << "Couldn't map pixel buffer for "
+                  << enum_stream_to_cstr(stream);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        return;
+    }
+    copy_image(static_cast<unsigned char*>(dst),
+               static_cast<const unsigned char*>(data), video_stream.width,
+               video_stream.height, bytes_per_pixel(stream),
+               texture.downsample);
+    unmap_pixel_buffer(pixel_buffer);
+
+    glBindTexture(GL_TEXTURE_2D, target);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
     glTexSubImage2D(GL_TEXTURE_2D,
                     0,     // mip level
                     0, 0,  // xoffset, yoffset
-                    _video_stream->width, _video_stream->height,
-                    current_format,  // format of incoming data
-                    GL_UNSIGNED_BYTE, current_data);
+                    width, height,
+                    format,  // format of incoming data
+                    type,
+                    nullptr);  // offset into the bound unpack buffer
     glBindTexture(GL_TEXTURE_2D, 0);
+
+    if (pixel_buffer.mapped != nullptr) {
+        pixel_buffer.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    }
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+    const auto duration = std::chrono::duration<float, std::milli>(
+        std::chrono::steady_clock::now() - tp_before);
+    perf::metrics().record(perf::Stage::Upload, duration.count());
+    texture.upload_stats.last_upload_ms = duration.count();
+    ++texture.upload_stats.uploaded;
+    texture.uploaded_frame = frame;
+
+    if (display_mode >= 0 &&
+        perf::metrics().is_enabled(perf::Stage::Colorize)) {
+        run_display_pass(texture, display_mode);
+    }
 }
 
 std::optional<ImVec2> Application::depth_picker() const {
@@ -352,8 +688,54 @@ std::optional<ImVec2> Application::depth_picker() const {
 
 void Application::update_depth_picker(float depth) { _depth_picker = depth; }
 
+void Application::update_overlay(
+    const std::vector<vision::Detection>& detections) {
+    // keeps the capacity of the previous overlay, labels fit in short strings
+    _overlay.assign(detections.begin(), detections.end());
+}
+
 bool Application::is_inference_enabled() const { return _is_inference_enabled; }
 
+bool Application::is_tracking_enabled() const {
+    return _is_tracking_enabled;
+}
+
+bool Application::is_motion_gate_enabled() const {
+    return _is_motion_gate_enabled;
+}
+
+bool Application::is_roi_enabled() const { return _is_roi_enabled; }
+
+bool Application::is_depth_gate_enabled() const {
+    return _is_depth_gate_enabled;
+}
+
+std::pair<float, float> Application::depth_range() const {
+    return {_depth_min, _depth_max};
+}
+
+float Application::motion_threshold() const { return _motion_threshold; }
+
+void Application::update_motion_score(float score) { _motion_score = score; }
+
+void Application::set_models(std::vector<std::string> names,
+                             std::string active) {
+    _models = std::move(names);
+    _selected_model = active;
+    _active_model = std::move(active);
+}
+
+const std::string& Application::selected_model() const {
+    return _selected_model;
+}
+
+void Application::update_model_status(std::string active, std::string loading,
+                                      std::string error) {
+    _active_model = std::move(active);
+    _loading_model = std::move(loading);
+    _model_error = std::move(error);
+}
+
 void Application::compose_frame() {
     ImGui_ImplOpenGL3_NewFrame();
     ImGui_ImplGlfw_NewFrame();
@@ -371,36 +753,23 @@ void Application::compose_frame() {
                      ImGuiWindowFlags_AlwaysAutoResize);
 
     if (_video_stream.has_value()) {
-        static bool mouse_click_recorded = false;
-        const auto content_pos = ImGui::GetCursorScreenPos();
-        const auto mouse_pos = ImGui::GetMousePos();
-        const auto relative_pos =
-            ImVec2(mouse_pos.x - content_pos.x, mouse_pos.y - content_pos.y);
-        if (relative_pos.x > 0 && relative_pos.x < _video_stream->width &&
-            relative_pos.y > 0 && relative_pos.y < _video_stream->height) {
-            _video_stream->mouse_pos = relative_pos;
-
-            if (ImGui::IsMouseDown(0) && !mouse_click_recorded) {
-                _video_stream->mouse_click = relative_pos;
-                mouse_click_recorded = true;
-            }
-            if (ImGui::IsMouseReleased(0)) {
-                mouse_click_recorded = false;
-            }
-        } else {
-            _video_stream->mouse_pos = std::nullopt;
-        }
+        const auto width = static_cast<float>(_video_stream->width);
+        const auto height = static_cast<float>(_video_stream->height);
 
-        ImVec2 imgSize(static_cast<float>(_video_stream->width),
-                       static_cast<float>(_video_stream->height));
-
-        // Many OpenGL backends expect ImTextureID to be the GLuint cast
-        // like this:
-        ImTextureID texId = (ImTextureID)(intptr_t)_video_stream->texture;
-        ImVec2 uv0(0.0f, 0.0f);
-        ImVec2 uv1(1.0f, 1.0f);
-        ImGui::Image(texId, imgSize, uv0, uv1);
+        _video_stream->mouse_pos = std::nullopt;
+        for (auto& texture : _video_stream->textures) {
+            texture.is_visible = false;
+        }
 
+        if (_is_tiled_view) {
+            const auto tile_size = ImVec2(width / 2.f, height / 2.f);
+            draw_stream(Stream::Color, tile_size);
+            ImGui::SameLine(0.f, 0.f);
+            draw_stream(Stream::Depth, tile_size);
+            draw_stream(Stream::IR, tile_size);
+        } else {
+            draw_stream(_current_stream, ImVec2(width, height));
+        }
     } else {
         LOG_ERROR << "Video stream is not initialized";
     }
@@ -426,11 +795,21 @@ void Application::compose_frame() {
         if (_depth_picker.has_value()) {
             ImGui::Text("Depth: %f", _depth_picker.value());
         }
+
+        for (int i = 0; i < static_cast<int>(Stream::MAX); ++i) {
+            const auto& upload_stats =
+                _video_stream->textures[i].upload_stats;
+            ImGui::Text("Upload %s: %.3f ms, %llu uploaded, %llu skipped",
+                        enum_stream_to_cstr(static_cast<Stream>(i)),
+                        upload_stats.last_upload_ms, upload_stats.uploaded,
+                        upload_stats.skipped);
+        }
     }
     ImGui::End();
 
     if (ImGui::Begin("Control")) {
         assert(!_stream_map.empty());
+        ImGui::BeginDisabled(_is_tiled_view);
         if (ImGui::BeginCombo("Stream", enum_stream_to_cstr(_current_stream))) {
             for (auto it = _stream_map.begin();
                  it != std::prev(_stream_map.end()); ++it) {
@@ -447,11 +826,57 @@ void Application::compose_frame() {
             }
             ImGui::EndCombo();
         }
+        ImGui::EndDisabled();
+
+        if (!_models.empty() &&
+            ImGui::BeginCombo("Model", _selected_model.c_str())) {
+            for (const auto& model : _models) {
+                const bool is_selected = _selected_model == model;
+                if (ImGui::Selectable(model.c_str(), is_selected)) {
+                    _selected_model = model;
+                }
+                if (is_selected) {
+                    ImGui::SetItemDefaultFocus();
+                }
+            }
+            ImGui::EndCombo();
+        }
+        if (!_loading_model.empty()) {
+            ImGui::Text("Loading %s, running %s", _loading_model.c_str(),
+                        _active_model.c_str());
+        } else if (!_model_error.empty()) {
+            ImGui::TextColored(ImVec4(1.f, 0.4f, 0.4f, 1.f), "%s",
+                               _model_error.c_str());
+        }
 
         ImGui::Checkbox("Enable inference", &_is_inference_enabled);
+        ImGui::BeginDisabled(!_is_inference_enabled);
+        ImGui::Checkbox("Track between keyframes", &_is_tracking_enabled);
+        ImGui::Checkbox("Crops around detections", &_is_roi_enabled);
+        ImGui::Checkbox("Ignore outside depth range", &_is_depth_gate_enabled);
+        ImGui::Checkbox("Skip static scenes", &_is_motion_gate_enabled);
+        ImGui::BeginDisabled(!_is_motion_gate_enabled);
+        ImGui::SliderFloat("Motion threshold", &_motion_threshold, 0.f, 20.f,
+                           "%.1f");
+        ImGui::Text("Motion score: %.2f", _motion_score);
+        ImGui::EndDisabled();
+        ImGui::EndDisabled();
+
+        const auto is_range_changed = ImGui::DragFloatRange2(
+            "Depth range", &_depth_min, &_depth_max, 0.01f, 0.f, 10.f,
+            "%.2f m", "%.2f m", ImGuiSliderFlags_AlwaysClamp);
+        if (is_range_changed && _video_stream.has_value()) {
+            // colorize the current frame again with the new range
+            _video_stream->textures[static_cast<int>(Stream::Depth)]
+                .uploaded_frame.reset();
+        }
+
+        ImGui::Checkbox("Tiled view", &_is_tiled_view);
 
         ImGui::End();
     }
+
+    draw_performance();
 }
 
 bool Application::should_close() const {
@@ -476,8 +901,248 @@ void Application::setVSync(bool flag) {
     glfwSwapInterval(static_cast<int>(flag));
 }
 
+void Application::draw_stream(Stream stream, ImVec2 size) {
+    auto& video_stream = _video_stream.value();
+    auto& texture = video_stream.textures[static_cast<int>(stream)];
+    const auto width = static_cast<float>(video_stream.width);
+    const auto height = static_cast<float>(video_stream.height);
+
+    // visibility and size take effect on the next upload
+    texture.is_visible = true;
+    texture.downsample =
+        (size.x * 2.f <= width && size.y * 2.f <= height) ? 2 : 1;
+
+    // mouse positions are reported in frame pixels
+    const auto image_pos = ImGui::GetCursorScreenPos();
+    const auto mouse_pos = ImGui::GetMousePos();
+    const auto relative_pos =
+        ImVec2((mouse_pos.x - image_pos.x) * width / size.x,
+               (mouse_pos.y - image_pos.y) * height / size.y);
+    if (relative_pos.x > 0 && relative_pos.x < width && relative_pos.y > 0 &&
+        relative_pos.y < height) {
+        video_stream.mouse_pos = relative_pos;
+
+        if (ImGui::IsMouseClicked(0)) {
+            video_stream.mouse_click = relative_pos;
+        }
+    }
+
+    // Many OpenGL backends expect ImTextureID to be the GLuint cast
+    // like this:
+    ImTextureID texId = (ImTextureID)(intptr_t)texture.texture;
+    ImVec2 uv0(0.0f, 0.0f);
+    ImVec2 uv1(downsampled_size(video_stream.width, texture.downsample) /
+                   width,
+               downsampled_size(video_stream.height, texture.downsample) /
+                   height);
+    ImGui::Image(texId, size, uv0, uv1);
+    draw_overlay(image_pos, size);
+}
+
+void Application::draw_performance() {
+    auto& metrics = perf::metrics();
+    auto& rates = _performance_rates;
+
+    // rates are refreshed twice a second to stay readable
+    const auto now = std::chrono::steady_clock::now();
+    const auto elapsed =
+        std::chrono::duration<float>(now - rates.tp_before).count();
+    if (elapsed >= 0.5f) {
+        const auto processed = metrics.get(perf::Counter::Processed);
+        const auto presented = metrics.get(perf::Counter::Presented);
+        rates.processed_fps = (processed - rates.processed) / elapsed;
+        rates.presented_fps = (presented - rates.presented) / elapsed;
+        rates.processed = processed;
+        rates.presented = presented;
+
+        for (std::size_t i = 0; i < rates.cpu_times.size(); ++i) {
+            const auto cpu_time =
+                metrics.cpu_time(static_cast<perf::Thread>(i));
+            const auto cpu_seconds =
+                std::chrono::duration<float>(cpu_time - rates.cpu_times[i]);
+            rates.cpu_usage[i] = 100.f * cpu_seconds.count() / elapsed;
+            rates.cpu_times[i] = cpu_time;
+        }
+        rates.tp_before = now;
+    }
+
+    if (!ImGui::Begin("Performance")) {
+        ImGui::End();
+        return;
+    }
+
+    ImGui::Text("Pipeline FPS: %.1f, presented FPS: %.1f",
+                rates.processed_fps, rates.presented_fps);
+
+    const auto flags = ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg;
+    if (ImGui::BeginTable("Stages", 5, flags)) {
+        ImGui::TableSetupColumn("Stage");
+        ImGui::TableSetupColumn("p50, ms");
+        ImGui::TableSetupColumn("p99, ms");
+        ImGui::TableSetupColumn("History");
+        ImGui::TableSetupColumn("On");
+        ImGui::TableHeadersRow();
+
+        std::array<float, perf::StageTimings::CAPACITY> samples;
+        std::array<float, perf::StageTimings::CAPACITY> sorted;
+        for (int i = 0; i < static_cast<int>(perf::Stage::MAX); ++i) {
+            const auto stage = static_cast<perf::Stage>(i);
+            const auto n = metrics.timings(stage).copy(samples);
+            std::copy_n(samples.begin(), n, sorted.begin());
+
+            ImGui::PushID(i);
+            ImGui::TableNextRow();
+            ImGui::TableNextColumn();
+            ImGui::TextUnformatted(perf::to_cstr(stage));
+            ImGui::TableNextColumn();
+            if (n > 0) {
+                ImGui::Text("%.3f", percentile(sorted, n, 0.5f));
+            }
+            ImGui::TableNextColumn();
+            if (n > 0) {
+                ImGui::Text("%.3f", percentile(sorted, n, 0.99f));
+            }
+            ImGui::TableNextColumn();
+            ImGui::PlotLines("##history", samples.data(), static_cast<int>(n),
+                             0, nullptr, 0.f, FLT_MAX, ImVec2(160.f, 24.f));
+            ImGui::TableNextColumn();
+            if (perf::Metrics::is_optional(stage)) {
+                auto is_enabled = metrics.is_enabled(stage);
+                if (ImGui::Checkbox("##enabled", &is_enabled)) {
+                    metrics.set_enabled(stage, is_enabled);
+                }
+            }
+            ImGui::PopID();
+        }
+        ImGui::EndTable();
+    }
+
+    for (int i = 0; i < static_cast<int>(perf::Counter::MAX); ++i) {
+        const auto counter = static_cast<perf::Counter>(i);
+        ImGui::Text("%s: %llu", perf::to_cstr(counter),
+                    static_cast<unsigned long long>(metrics.get(counter)));
+    }
+    for (int i = 0; i < static_cast<int>(perf::Gauge::MAX); ++i) {
+        const auto gauge = static_cast<perf::Gauge>(i);
+        ImGui::Text("%s: %lld", perf::to_cstr(gauge),
+                    static_cast<long long>(metrics.get(gauge)));
+    }
+    for (std::size_t i = 0; i < rates.cpu_usage.size(); ++i) {
+        ImGui::Text("%s thread CPU: %.1f%%",
+                    perf::to_cstr(static_cast<perf::Thread>(i)),
+                    rates.cpu_usage[i]);
+    }
+    for (int i = 0; i < static_cast<int>(perf::Milestone::MAX); ++i) {
+        const auto milestone = static_cast<perf::Milestone>(i);
+        if (const auto ms = metrics.since_start(milestone); ms.has_value()) {
+            ImGui::Text("%s after: %.0f ms", perf::to_cstr(milestone), *ms);
+        } else {
+            ImGui::Text("%s after: -", perf::to_cstr(milestone));
+        }
+    }
+
+    ImGui::End();
+}
+
+void Application::run_display_pass(const StreamTexture& texture,
+                                   int mode) const {
+    if (!_display_pass.has_value()) {
+        LOG_ERROR << "Display pass is not initialized";
+        return;
+    }
+
+    // measures submission only, the GPU runs the pass asynchronously
+    const auto timer = perf::ScopedTimer{perf::Stage::Colorize};
+
+    const auto& pass = _display_pass.value();
+    const auto& stream = _video_stream.value();
+
+    // a downsampled upload only fills the top left part of the textures
+    glBindFramebuffer(GL_FRAMEBUFFER, texture.framebuffer);
+    const auto width = downsampled_size(stream.width, texture.downsample);
+    const auto height = downsampled_size(stream.height, texture.downsample);
+    glViewport(0, 0, width, height);
+    glUseProgram(pass.program);
+
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, texture.raw_texture);
+    glActiveTexture(GL_TEXTURE1);
+    glBindTexture(GL_TEXTURE_2D, pass.palette);
+
+    glUniform1i(pass.source_location, 0);
+    glUniform1i(pass.palette_location, 1);
+    glUniform1i(pass.mode_location, mode);
+    // R16 is sampled normalized to [0, 1]
+    glUniform1f(pass.depth_units_location, stream.depth_scale * 65535.f);
+    glUniform2f(pass.depth_range_location, _depth_min, _depth_max);
+    glUniform2f(pass.uv_scale_location,
+                static_cast<float>(width) / stream.width,
+                static_cast<float>(height) / stream.height);
+
+    glBindVertexArray(pass.vertex_array);
+    glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+
+    glBindVertexArray(0);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glUseProgram(0);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+void Application::draw_overlay(ImVec2 image_pos, ImVec2 image_size) const {
+    if (_overlay.empty() || !perf::metrics().is_enabled(perf::Stage::Overlay)) {
+        return;
+    }
+
+    const auto timer = perf::ScopedTimer{perf::Stage::Overlay};
+
+    // detections are in frame pixels, the image may be drawn scaled
+    const auto sx = image_size.x / static_cast<float>(_video_stream->width);
+    const auto sy = image_size.y / static_cast<float>(_video_stream->height);
+    const auto box_color = IM_COL32(252, 119, 30, 255);
+    const auto text_color = IM_COL32(255, 255, 255, 255);
+
+    const auto image_end =
+        ImVec2(image_pos.x + image_size.x, image_pos.y + image_size.y);
+
+    auto* draw_list = ImGui::GetWindowDrawList();
+    draw_list->PushClipRect(image_pos, image_end, true);
+
+    char label[128];
+    for (const auto& d : _overlay) {
+        const auto p0 =
+            ImVec2(image_pos.x + d.box.x * sx, image_pos.y + d.box.y * sy);
+        const auto p1 = ImVec2(image_pos.x + (d.box.x + d.box.width) * sx,
+                               image_pos.y + (d.box.y + d.box.height) * sy);
+        draw_list->AddRect(p0, p1, box_color, 0.f, 0, 2.f);
+
+        auto n = 0;
+        if (d.track_id >= 0) {
+            n = std::snprintf(label, sizeof(label), "#%d ", d.track_id);
+        }
+        if (std::isnan(d.distance)) {
+            std::snprintf(label + n, sizeof(label) - n, "%s n/a %.2f",
+                          d.label.c_str(), d.score);
+        } else {
+            std::snprintf(label + n, sizeof(label) - n, "%s %.2fm %.2f",
+                          d.label.c_str(), d.distance, d.score);
+        }
+
+        const auto text_size = ImGui::CalcTextSize(label);
+        const auto ty = std::max(image_pos.y, p0.y - text_size.y - 6.f);
+        draw_list->AddRectFilled(
+            ImVec2(p0.x, ty),
+            ImVec2(p0.x + text_size.x + 6.f, ty + text_size.y + 6.f),
+            box_color);
+        draw_list->AddText(ImVec2(p0.x + 3.f, ty + 3.f), text_color, label);
+    }
+
+    draw_list->PopClipRect();
+}
+
 const char* Application::enum_stream_to_cstr(Stream stream) const {
-    assert(stream < map.size());
+    assert(_stream_map.contains(stream));
     return _stream_map.at(stream).c_str();
 }
 
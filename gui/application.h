@@ -1,15 +1,22 @@
 #pragma once
 
 #include <array>
+#include <chrono>
+#include <cstdint>
 #include <map>
 #include <optional>
 #include <string>
+#include <utility>
+#include <vector>
 
 #include <glad/glad.h>
 
 #include <GLFW/glfw3.h>
 #include <imgui.h>
 
+#include "perf/metrics.h"
+#include "vision/parsers/parser.h"
+
 namespace gui {
 
 class Application {
@@ -22,26 +29,113 @@ class Application {
         float hiDPIScale;
     };
 
+    enum class Stream { Color, Depth, IR, MAX };
+
+    // Pixel unpack buffer the texture is uploaded from. When buffer storage
+    // is available the buffer stays persistently mapped and the fence guards
+    // against overwriting it while the GPU still reads the previous upload.
+    struct PixelBuffer {
+        GLuint buffer = 0;
+        void* mapped = nullptr;
+        GLsync fence = nullptr;
+    };
+
+    // Renders the raw depth and infrared textures into the displayed texture
+    struct DisplayPass {
+        unsigned program = 0;
+        unsigned vertex_array = 0;
+        unsigned vertex_buffer = 0;
+        unsigned palette = 0;
+        int source_location = -1;
+        int palette_location = -1;
+        int mode_location = -1;
+        int depth_units_location = -1;
+        int depth_range_location = -1;
+        int uv_scale_location = -1;
+    };
+
+    struct UploadStats {
+        unsigned long long uploaded = 0;
+        unsigned long long skipped = 0;
+        float last_upload_ms = 0.f;
+    };
+
+    // frames of a stream in flight to the GPU before the oldest buffer is
+    // written again
+    static constexpr std::size_t PIXEL_BUFFERS_NUM = 3;
+
+    // Each stream has its own displayed texture. Depth and infrared are
+    // uploaded into the raw texture first and rendered into it by the
+    // display pass; color is uploaded into it directly. Every stream cycles
+    // through its own ring of pixel buffers sized for its pixel format.
+    struct StreamTexture {
+        unsigned texture = 0;
+        unsigned raw_texture = 0;
+        unsigned framebuffer = 0;
+        std::array<PixelBuffer, PIXEL_BUFFERS_NUM> pixel_buffers;
+        std::size_t pixel_buffer_index = 0;
+        std::size_t pixel_buffer_size = 0;
+        // 1 for full resolution, 2 when only every other row and column is
+        // uploaded because the view is displayed at half size or less
+        int downsample = 1;
+        bool is_visible = false;
+        std::optional<std::pair<unsigned long long, int>> uploaded_frame;
+        UploadStats upload_stats;
+    };
+
     struct VideoStream {
         int width;
         int height;
-        unsigned texture;
+        float depth_scale;
+        std::array<StreamTexture, static_cast<std::size_t>(Stream::MAX)>
+            textures;
         std::optional<ImVec2> mouse_pos;
         std::optional<ImVec2> mouse_click;
     };
 
-    enum class Stream { Color, Depth, IR, MAX };
+    // Rates shown by the performance window, refreshed periodically from
+    // the perf::metrics() counters
+    struct PerformanceRates {
+        std::chrono::steady_clock::time_point tp_before;
+        std::uint64_t processed = 0;
+        std::uint64_t presented = 0;
+        std::array<std::chrono::nanoseconds,
+                   static_cast<std::size_t>(perf::Thread::MAX)>
+            cpu_times{};
+        float processed_fps = 0.f;
+        float presented_fps = 0.f;
+        std::array<float, static_cast<std::size_t>(perf::Thread::MAX)>
+            cpu_usage{};
+    };
 
     Application() = default;
     ~Application();
 
     [[nodiscard]] bool init(int width, int height, std::string title);
-    void create_video_stream(int width, int height);
-    void update_video_stream(unsigned char* color_bgr, unsigned char* depth_rgb,
-                             unsigned char* ir_y8) const;
+    void create_video_stream(int width, int height, float depth_scale);
+    void update_video_stream(const unsigned char* color_bgr,
+                             const unsigned short* depth_z16,
+                             const unsigned char* ir_y8,
+                             unsigned long long frame_id);
     std::optional<ImVec2> depth_picker() const;
     void update_depth_picker(float depth);
+    void update_overlay(const std::vector<vision::Detection>& detections);
     bool is_inference_enabled() const;
+    bool is_tracking_enabled() const;
+    bool is_motion_gate_enabled() const;
+    bool is_roi_enabled() const;
+    bool is_depth_gate_enabled() const;
+    // meters, shared by the depth colorization and the depth gate
+    std::pair<float, float> depth_range() const;
+    float motion_threshold() const;
+    void update_motion_score(float score);
+    // models to pick from, the selection starts at active
+    void set_models(std::vector<std::string> names, std::string active);
+    const std::string& selected_model() const;
+    // the model being run and loaded and why the last load failed, empty
+    // when there is none
+    void update_model_status(std::string active, std::string loading,
+                             std::string error);
     void compose_frame();
     bool should_close() const;
     void render() const;
@@ -51,19 +145,44 @@ class Application {
 
    private:
     const char* enum_stream_to_cstr(Stream stream) const;
+    void draw_overlay(ImVec2 image_pos, ImVec2 image_size) const;
+    void upload_stream(Stream stream, const void* data,
+                       unsigned long long frame_id);
+    void run_display_pass(const StreamTexture& texture, int mode) const;
+    void draw_stream(Stream stream, ImVec2 size);
+    void draw_performance();
 
     bool _is_vsync_enabled = true;
     Stream _current_stream = Stream::Color;
+    bool _is_tiled_view = false;
     bool _is_inference_enabled = false;
+    bool _is_tracking_enabled = false;
+    bool _is_motion_gate_enabled = false;
+    bool _is_roi_enabled = false;
+    bool _is_depth_gate_enabled = false;
+    float _motion_threshold = 3.f;
+    float _motion_score = 0.f;
+    std::vector<std::string> _models;
+    std::string _selected_model;
+    std::string _active_model;
+    std::string _loading_model;
+    std::string _model_error;
 
     std::map<Stream, std::string> _stream_map{{Stream::Color, "color"},
                                               {Stream::Depth, "depth"},
                                               {Stream::IR, "infrared"},
                                               {Stream::MAX, "invalid"}};
 
+    // colorized depth range in meters
+    float _depth_min = 0.3f;
+    float _depth_max = 4.f;
+
     std::optional<Window> _window;
+    std::optional<DisplayPass> _display_pass;
     std::optional<VideoStream> _video_stream;
     std::optional<float> _depth_picker;
+    std::vector<vision::Detection> _overlay;
+    PerformanceRates _performance_rates;
 };
 
 }  // namespace gui
@@ -0,0 +1,132 @@
+#include "reader.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+
+namespace {
+
+// attempts at the newest frame before giving up on a writer that keeps
+// overwriting it
+constexpr int READ_ATTEMPTS = 4;
+
+}  // namespace
+
+namespace ipc {
+
+RingReader::RingReader(const std::string& name) : _name(shm_name(name)) {
+    const auto fd = shm_open(_name.c_str(), O_RDONLY, 0);
+    if (fd < 0) {
+        throw std::runtime_error{"Failed to open shared memory " + _name +
+                                 ": " + std::strerror(errno)};
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0 ||
+        static_cast<std::size_t>(info.st_size) < sizeof(RingHeader)) {
+        close(fd);
+        throw std::runtime_error{"Shared memory " + _name +
+                                 " is not a frame ring"};
+    }
+    _size = static_cast<std::size_t>(info.st_size);
+    auto* data = mmap(nullptr, _size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        throw std::runtime_error{"Failed to map shared memory " + _name +
+                                 ": " + std::strerror(errno)};
+    }
+    _data = static_cast<const std::byte*>(data);
+    _header = reinterpret_cast<const RingHeader*>(_data);
+
+    const auto fail = [this](const std::string& reason) {
+        munmap(const_cast<std::byte*>(_data), _size);
+        throw std::runtime_error{"Shared memory " + _name + " " + reason};
+    };
+    if (_header->magic.load(std::memory_order_acquire) != RING_MAGIC) {
+        fail("is not a frame ring or not initialized yet");
+    }
+    if (_header->version != RING_VERSION) {
+        fail("has ring version " + std::to_string(_header->version) +
+             " (expected " + std::to_string(RING_VERSION) + ")");
+    }
+    _planes = planes_of(_header->width, _header->height);
+    if (_header->slot_size != _planes.end ||
+        _size < ring_size(_header->slots_num, _header->width,
+                          _header->height)) {
+        fail("has an unexpected size");
+    }
+}
+
+RingReader::~RingReader() { munmap(const_cast<std::byte*>(_data), _size); }
+
+std::optional<FrameView> RingReader::latest() const {
+    for (int i = 0; i < READ_ATTEMPTS; ++i) {
+        const auto published =
+            _header->published.load(std::memory_order_acquire);
+        if (published == 0) {
+            return std::nullopt;
+        }
+
+        const auto* slot =
+            _data + align_up(sizeof(RingHeader)) +
+            (published - 1) % _header->slots_num * _planes.end;
+        const auto& header = *reinterpret_cast<const SlotHeader*>(slot);
+        const auto sequence = header.sequence.load(std::memory_order_acquire);
+        if (sequence % 2 != 0) {
+            // lapped, the writer is back in this slot already
+            continue;
+        }
+        return FrameView{
+            .sequence = sequence,
+            .slot = &header,
+            .frame = &header.frame,
+            .detections = header.detections,
+            .color =
+                reinterpret_cast<const std::uint8_t*>(slot + _planes.color),
+            .depth =
+                reinterpret_cast<const std::uint16_t*>(slot + _planes.depth),
+            .ir = reinterpret_cast<const std::uint8_t*>(slot + _planes.ir)};
+    }
+    return std::nullopt;
+}
+
+bool RingReader::is_valid(const FrameView& view) const {
+    // reads of the view happen before the sequence is checked again
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return view.slot->sequence.load(std::memory_order_relaxed) ==
+           view.sequence;
+}
+
+std::optional<FrameHeader> RingReader::copy(const FrameView& view,
+                                            DetectionRecord* detections,
+                                            std::uint8_t* color,
+                                            std::uint16_t* depth,
+                                            std::uint8_t* ir) const {
+    const auto pixels = std::size_t{_header->width} * _header->height;
+    const auto frame = *view.frame;
+    std::memcpy(detections, view.detections,
+                std::min<std::size_t>(frame.detections_num, MAX_DETECTIONS) *
+                    sizeof(DetectionRecord));
+    std::memcpy(color, view.color, pixels * 3);
+    std::memcpy(depth, view.depth, pixels * sizeof(std::uint16_t));
+    std::memcpy(ir, view.ir, pixels);
+    if (!is_valid(view)) {
+        return std::nullopt;
+    }
+    return frame;
+}
+
+std::uint64_t RingReader::published() const {
+    return _header->published.load(std::memory_order_acquire);
+}
+
+std::uint32_t RingReader::width() const { return _header->width; }
+
+std::uint32_t RingReader::height() const { return _header->height; }
+
+}  // namespace ipc
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+
+#include "ring.h"
+
+namespace ipc {
+
+// A published frame, read in place from the shared memory. The writer may
+// reuse the slot at any time, so whatever was read from the view only
+// counts if is_valid() still holds afterwards.
+struct FrameView {
+    std::uint64_t sequence;
+    const SlotHeader* slot;
+    const FrameHeader* frame;
+    const DetectionRecord* detections;
+    // width * height BGR8, Z16 and Y8, rows without padding
+    const std::uint8_t* color;
+    const std::uint16_t* depth;
+    const std::uint8_t* ir;
+};
+
+// Maps a ring created by a RingWriter read only. Never blocks and never
+// writes, so readers can't stall the writer or each other.
+class RingReader {
+   public:
+    // throws when there is no ring of that name or it has another layout
+    explicit RingReader(const std::string& name);
+    ~RingReader();
+
+    RingReader(const RingReader&) = delete;
+    RingReader& operator=(const RingReader&) = delete;
+
+    // the newest frame, nullopt when none is published yet or the writer
+    // kept lapping the reader
+    std::optional<FrameView> latest() const;
+    bool is_valid(const FrameView& view) const;
+    // copies the frame out, nullopt when it was overwritten meanwhile;
+    // buffers must hold width * height pixels of each plane
+    std::optional<FrameHeader> copy(const FrameView& view,
+                                    DetectionRecord* detections,
+                                    std::uint8_t* color, std::uint16_t* depth,
+                                    std::uint8_t* ir) const;
+
+    // frames published so far, to wait for a new one
+    std::uint64_t published() const;
+    std::uint32_t width() const;
+    std::uint32_t height() const;
+
+   private:
+    std::string _name;
+    std::size_t _size = 0;
+    const std::byte* _data = nullptr;
+    const RingHeader* _header = nullptr;
+    Planes _planes;
+};
+
+}  // namespace ipc
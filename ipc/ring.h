@@ -0,0 +1,125 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Layout of the shared memory ring frames and detections are published
+// through. Everything in it is plain data so readers don't need librealsense
+// or OpenCV, only this header and the reader.
+//
+//   RingHeader | slot 0 | slot 1 | ... | slot N-1
+//   slot: SlotHeader | color BGR8 | depth Z16 | infrared Y8
+//
+// Each slot is a seqlock: the writer makes its sequence odd before writing
+// and even again after, readers compare the sequence before and after they
+// read the slot and discard what they read if it changed. Readers never
+// write to the ring, so any number of them can't slow the writer down.
+
+namespace ipc {
+
+inline constexpr std::uint32_t RING_MAGIC = 0x52534652;  // "RSFR"
+inline constexpr std::uint32_t RING_VERSION = 1;
+
+inline constexpr std::size_t LABEL_SIZE = 32;
+inline constexpr std::size_t MAX_DETECTIONS = 128;
+// cache line, image planes start on one
+inline constexpr std::size_t ALIGNMENT = 64;
+
+static_assert(std::atomic<std::uint64_t>::is_always_lock_free,
+              "the ring needs lock-free 64 bit atomics in shared memory");
+
+// pinhole model of the color stream, which depth is aligned to
+struct Intrinsics {
+    std::int32_t width = 0;
+    std::int32_t height = 0;
+    float ppx = 0.f;
+    float ppy = 0.f;
+    float fx = 0.f;
+    float fy = 0.f;
+    // rs2_distortion, 0 is none
+    std::int32_t model = 0;
+    float coeffs[5] = {};
+};
+
+struct DetectionRecord {
+    std::int32_t class_id;
+    // -1 when not tracked
+    std::int32_t track_id;
+    float score;
+    // meters, NaN if unknown
+    float distance;
+    std::int32_t x;
+    std::int32_t y;
+    std::int32_t width;
+    std::int32_t height;
+    // NUL terminated, truncated to fit
+    char label[LABEL_SIZE];
+};
+
+struct FrameHeader {
+    std::uint64_t number;
+    // milliseconds, as reported by librealsense
+    double timestamp;
+    float depth_scale;
+    std::uint32_t is_keyframe;
+    Intrinsics intrinsics;
+    std::uint32_t detections_num;
+};
+
+struct alignas(ALIGNMENT) SlotHeader {
+    // odd while the writer is in the slot
+    std::atomic<std::uint64_t> sequence;
+    FrameHeader frame;
+    DetectionRecord detections[MAX_DETECTIONS];
+};
+
+struct alignas(ALIGNMENT) RingHeader {
+    // written last, once the rest of the header is valid
+    std::atomic<std::uint32_t> magic;
+    std::uint32_t version;
+    std::uint32_t slots_num;
+    std::uint32_t width;
+    std::uint32_t height;
+    std::uint64_t slot_size;
+    // frames published so far, the newest is in slot (published - 1) %
+    // slots_num
+    std::atomic<std::uint64_t> published;
+};
+
+constexpr std::size_t align_up(std::size_t size) {
+    return (size + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+}
+
+// byte offsets of the image planes from the start of a slot
+struct Planes {
+    std::size_t color;
+    std::size_t depth;
+    std::size_t ir;
+    // slot size
+    std::size_t end;
+};
+
+constexpr Planes planes_of(std::size_t width, std::size_t height) {
+    const auto color = align_up(sizeof(SlotHeader));
+    const auto depth = color + align_up(width * height * 3);
+    const auto ir = depth + align_up(width * height * 2);
+    return {.color = color,
+            .depth = depth,
+            .ir = ir,
+            .end = ir + align_up(width * height)};
+}
+
+constexpr std::size_t ring_size(std::size_t slots_num, std::size_t width,
+                                std::size_t height) {
+    return align_up(sizeof(RingHeader)) +
+           slots_num * planes_of(width, height).end;
+}
+
+// POSIX shared memory names start with a slash, which callers may leave out
+inline std::string shm_name(const std::string& name) {
+    return name.starts_with('/') ? name : "/" + name;
+}
+
+}  // namespace ipc
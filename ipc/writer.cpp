@@ -0,0 +1,118 @@
+#include "writer.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+#include <new>
+#include <stdexcept>
+
+namespace {
+
+std::runtime_error system_error(const std::string& what,
+                                const std::string& name) {
+    return std::runtime_error{what + " " + name + ": " +
+                              std::strerror(errno)};
+}
+
+}  // namespace
+
+namespace ipc {
+
+RingWriter::RingWriter(const std::string& name, std::uint32_t width,
+                       std::uint32_t height, std::uint32_t slots_num)
+    : _name(shm_name(name)),
+      _size(ring_size(slots_num, width, height)),
+      _planes(planes_of(width, height)) {
+    if (width == 0 || height == 0 || slots_num == 0) {
+        throw std::runtime_error{"Empty shared memory ring " + _name};
+    }
+
+    // A ring left over from a writer that crashed or restarted may still be
+    // mapped by readers. Truncating it would make their next access fault,
+    // so it is unlinked and a new object created instead; the old one lives
+    // on until its last reader unmaps it. Readers map it read only.
+    shm_unlink(_name.c_str());
+    const auto fd = shm_open(_name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+    if (fd < 0) {
+        throw system_error("Failed to create shared memory", _name);
+    }
+    if (ftruncate(fd, static_cast<off_t>(_size)) != 0) {
+        const auto error = system_error("Failed to size shared memory", _name);
+        close(fd);
+        shm_unlink(_name.c_str());
+        throw error;
+    }
+    auto* data =
+        mmap(nullptr, _size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        const auto error = system_error("Failed to map shared memory", _name);
+        shm_unlink(_name.c_str());
+        throw error;
+    }
+    _data = static_cast<std::byte*>(data);
+
+    // ftruncate zero fills, which is a valid state for every slot: sequence
+    // 0 and no frame published
+    _header = new (_data) RingHeader{};
+    _header->version = RING_VERSION;
+    _header->slots_num = slots_num;
+    _header->width = width;
+    _header->height = height;
+    _header->slot_size = _planes.end;
+    for (std::uint64_t i = 0; i < slots_num; ++i) {
+        new (&slot_header(i)) SlotHeader{};
+    }
+    _header->magic.store(RING_MAGIC, std::memory_order_release);
+}
+
+RingWriter::~RingWriter() {
+    munmap(_data, _size);
+    shm_unlink(_name.c_str());
+}
+
+RingWriter::Slot RingWriter::begin() {
+    auto& header = slot_header(_published);
+    if (!_is_writing) {
+        // odd, then a release fence so the sequence change is visible before
+        // any of the writes to the slot
+        header.sequence.store(
+            header.sequence.load(std::memory_order_relaxed) + 1,
+            std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        _is_writing = true;
+    }
+
+    auto* slot = reinterpret_cast<std::byte*>(&header);
+    return {.frame = header.frame,
+            .detections = header.detections,
+            .color = reinterpret_cast<std::uint8_t*>(slot + _planes.color),
+            .depth = reinterpret_cast<std::uint16_t*>(slot + _planes.depth),
+            .ir = reinterpret_cast<std::uint8_t*>(slot + _planes.ir)};
+}
+
+void RingWriter::commit() {
+    if (!_is_writing) {
+        return;
+    }
+    auto& header = slot_header(_published);
+    header.sequence.store(header.sequence.load(std::memory_order_relaxed) + 1,
+                          std::memory_order_release);
+    _header->published.store(++_published, std::memory_order_release);
+    _is_writing = false;
+}
+
+std::uint32_t RingWriter::width() const { return _header->width; }
+
+std::uint32_t RingWriter::height() const { return _header->height; }
+
+SlotHeader& RingWriter::slot_header(std::uint64_t index) {
+    const auto offset = align_up(sizeof(RingHeader)) +
+                        (index % _header->slots_num) * _planes.end;
+    return *reinterpret_cast<SlotHeader*>(_data + offset);
+}
+
+}  // namespace ipc
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "ring.h"
+
+namespace ipc {
+
+// Creates the shared memory ring and publishes frames into it. There is one
+// writer per ring; the segment is unlinked when the writer goes away, readers
+// that still have it mapped keep the last frames but see nothing new.
+class RingWriter {
+   public:
+    struct Slot {
+        FrameHeader& frame;
+        DetectionRecord* detections;
+        std::uint8_t* color;
+        std::uint16_t* depth;
+        std::uint8_t* ir;
+    };
+
+    // replaces a ring of the same name left over from a writer that crashed
+    // with a new segment, readers still mapping the old one are unaffected
+    // and pick up the new one when they reattach by name
+    RingWriter(const std::string& name, std::uint32_t width,
+               std::uint32_t height, std::uint32_t slots_num);
+    ~RingWriter();
+
+    RingWriter(const RingWriter&) = delete;
+    RingWriter& operator=(const RingWriter&) = delete;
+
+    // The slot the next frame goes to. Readers ignore it until commit(),
+    // including the frame that was in it before.
+    Slot begin();
+    void commit();
+
+    std::uint32_t width() const;
+    std::uint32_t height() const;
+
+   private:
+    SlotHeader& slot_header(std::uint64_t index);
+
+    std::string _name;
+    std::size_t _size = 0;
+    std::byte* _data = nullptr;
+    RingHeader* _header = nullptr;
+    Planes _planes;
+    // frames published so far, only the writer changes it
+    std::uint64_t _published = 0;
+    bool _is_writing = false;
+};
+
+}  // namespace ipc
@@ -1,7 +1,15 @@
+#include <atomic>
 #include <chrono>
+#include <csignal>
 #include <future>
+#include <iostream>
+#include <memory>
 #include <numeric>
+#include <optional>
+#include <sstream>
 #include <string>
+#include <string_view>
+#include <thread>
 
 #include <plog/Formatters/TxtFormatter.h>
 #include <plog/Initializers/ConsoleInitializer.h>
@@ -9,108 +17,429 @@
 #include <opencv2/opencv.hpp>
 
 #include "gui/application.h"
-#include "render.h"
+#include "perf/metrics.h"
 #include "vision/camera.h"
+#include "vision/core_budget.h"
+#include "vision/detection_log.h"
 #include "vision/detector.h"
 #include "vision/factory.h"
+#include "vision/model_registry.h"
+#include "vision/multi_detector.h"
+#include "vision/pipeline.h"
+#include "vision/shm_publisher.h"
+#include "vision/tiled_detector.h"
+#include "vision/sink.h"
 
 const float OBJ_THRESH = 0.25f;
 const float SCORE_THRESH = 0.35f;
 const float NMS_THRESH = 0.45f;
 
-int main() {
-    plog::init<plog::TxtFormatter>(plog::debug, plog::streamStdOut);
+namespace {
 
-    gui::Application app{};
-    if (const auto is_app_ok = app.init(1280, 720, "RealSense Capture");
-        !is_app_ok) {
-        LOG_ERROR << "Couldn't initialize GUI application";
-        return EXIT_FAILURE;
+struct Options {
+    // no window, every processed frame goes to the results sink
+    bool is_headless = false;
+    // results sink path for the headless mode, "-" is stdout
+    std::string output = "-";
+    // name of the model to start with
+    std::optional<std::string> model;
+    // models run on every frame next to the first one
+    std::vector<std::string> extra_models;
+    // headless only, detector on keyframes and the tracker in between
+    bool is_tracking_enabled = false;
+    // headless only, skips the detector while the scene is static
+    std::optional<float> motion_threshold;
+    // headless only, detector on crops around earlier detections
+    bool is_roi_enabled = false;
+    // square size crops are letterboxed to, 0 for the model's input size
+    int roi_size = 0;
+    // the models were exported with dynamic axes and take any input size
+    bool is_input_dynamic = false;
+    // headless only, working volume in meters outside of which objects are
+    // ignored
+    std::optional<std::pair<float, float>> depth_range;
+    // shared memory ring other processes read frames and detections from
+    std::optional<std::string> shm_name;
+    // binary detection log appended to in the background
+    std::optional<std::string> log_path;
+    // detectors running tiles of the frame in parallel, 0 disables tiling
+    int tiled_pool_size = 0;
+    // frames are copied out of librealsense into recycled buffers
+    bool is_frame_pool_enabled = false;
+    // OpenCV's pool size and the cores each thread runs on
+    vision::CoreBudgetConfig core_budget;
+    bool is_vsync_enabled = true;
+};
+
+std::optional<Options> parse_options(int argc, char** argv) {
+    Options options;
+    for (int i = 1; i < argc; ++i) {
+        const auto arg = std::string_view{argv[i]};
+        if (arg == "--headless") {
+            options.is_headless = true;
+        } else if (arg == "--output" && i + 1 < argc) {
+            options.output = argv[++i];
+        } else if (arg == "--model" && i + 1 < argc) {
+            options.model = argv[++i];
+        } else if (arg == "--extra-models" && i + 1 < argc) {
+            auto list = std::istringstream{argv[++i]};
+            for (std::string name; std::getline(list, name, ',');) {
+                options.extra_models.push_back(name);
+            }
+        } else if (arg == "--tracking") {
+            options.is_tracking_enabled = true;
+        } else if (arg == "--motion-gate" && i + 1 < argc) {
+            options.motion_threshold = std::stof(argv[++i]);
+        } else if (arg == "--roi") {
+            options.is_roi_enabled = true;
+        } else if (arg == "--roi-size" && i + 1 < argc) {
+            options.roi_size = std::stoi(argv[++i]);
+        } else if (arg == "--dynamic-input") {
+            options.is_input_dynamic = true;
+        } else if (arg == "--depth-range" && i + 2 < argc) {
+            options.depth_range = std::pair{std::stof(argv[i + 1]),
+                                            std::stof(argv[i + 2])};
+            i += 2;
+        } else if (arg == "--tiled" && i + 1 < argc) {
+            options.tiled_pool_size = std::stoi(argv[++i]);
+        } else if (arg == "--shm" && i + 1 < argc) {
+            options.shm_name = argv[++i];
+        } else if (arg == "--log" && i + 1 < argc) {
+            options.log_path = argv[++i];
+        } else if (arg == "--frame-pool") {
+            options.is_frame_pool_enabled = true;
+        } else if (arg == "--cv-threads" && i + 1 < argc) {
+            options.core_budget.cv_threads = std::stoi(argv[++i]);
+        } else if (arg == "--capture-cores" && i + 1 < argc) {
+            options.core_budget.capture_cores = vision::parse_cores(argv[++i]);
+        } else if (arg == "--inference-cores" && i + 1 < argc) {
+            options.core_budget.inference_cores =
+                vision::parse_cores(argv[++i]);
+        } else if (arg == "--gui-cores" && i + 1 < argc) {
+            options.core_budget.gui_cores = vision::parse_cores(argv[++i]);
+        } else if (arg == "--capture-priority") {
+            options.core_budget.is_capture_priority_raised = true;
+        } else if (arg == "--no-vsync") {
+            options.is_vsync_enabled = false;
+        } else {
+            // logging isn't initialized yet
+            std::cerr << "Unknown argument: " << arg << "\n"
+                      << "Usage: " << argv[0]
+                      << " [--model coco|rps|coco-yolov5]"
+                         " [--extra-models <name,...>]"
+                         " [--headless [--output <path|->] [--tracking]"
+                         " [--motion-gate <threshold>]"
+                         " [--roi [--roi-size <px>]]"
+                         " [--depth-range <min> <max>]]"
+                         " [--dynamic-input]"
+                         " [--tiled <pool size>] [--shm <name>]"
+                         " [--log <path>] [--frame-pool] [--cv-threads N]"
+                         " [--capture-cores <list>]"
+                         " [--inference-cores <list>] [--gui-cores <list>]"
+                         " [--capture-priority] [--no-vsync]\n";
+            return std::nullopt;
+        }
     }
+    // the tiled detector runs the detector alone on every tile
+    if (options.tiled_pool_size > 0 && !options.extra_models.empty()) {
+        std::cerr << "--tiled and --extra-models can't be combined\n";
+        return std::nullopt;
+    }
+    return options;
+}
 
-    auto runtime =
-        vision::make_runtime(vision::ModelType::YOLOv8, "yolov12n.onnx",
-                             "coco.names", 640, 640, cv::Scalar(114, 114, 114));
-    // vision::make_runtime(vision::ModelType::YOLOv5,
-    // "yolov5s.onnx",
-    //                      "coco.names", 640, 640, cv::Scalar(114,
-    //                      114, 114));
-    // vision::make_runtime(vision::ModelType::YOLOv8, "RPS-12.onnx",
-    //                      "RPS.names", 640, 640, cv::Scalar(114, 114, 114));
-    auto detector = vision::Detector(std::move(runtime));
-    auto camera = vision::Camera(848, 480, 60);
-    const auto thresholds = vision::Thresholds{
-        .score = SCORE_THRESH, .nms = NMS_THRESH, .objectness = OBJ_THRESH};
+std::atomic<bool> is_interrupted = false;
 
-    auto print_fps = [tp_before =
-                          std::chrono::steady_clock::now()]() mutable -> void {
-        using namespace std::chrono;
-        const auto tp_after = steady_clock::now();
-        const auto duration = duration_cast<milliseconds>(tp_after - tp_before);
-        tp_before = tp_after;
+void on_interrupt(int) { is_interrupted = true; }
 
-        std::cout << std::fixed << std::setprecision(2)
-                  << "fps: " << 1000.f / duration.count() << "\n";
-    };
+void report(perf::Milestone milestone) {
+    if (const auto ms = perf::metrics().mark(milestone); ms.has_value()) {
+        LOG_INFO << "Startup: " << perf::to_cstr(milestone) << " after "
+                 << *ms << " ms";
+    }
+}
+
+struct LoadedModels {
+    // one for the detector and one per tiled detector
+    std::vector<vision::ModelRuntime> runtimes;
+    std::vector<vision::ModelRuntime> extra_runtimes;
+};
 
-    app.create_video_stream(848, 480);
-    app.setVSync(true);
+int run_headless(const Options& options, vision::Pipeline& pipeline) {
+    std::signal(SIGINT, on_interrupt);
+    std::signal(SIGTERM, on_interrupt);
 
-    std::vector<vision::Detection> detections;
-    detections.reserve(32);
+    pipeline.set_inference_enabled(true);
+    pipeline.set_tracking_enabled(options.is_tracking_enabled);
+    pipeline.set_roi_enabled(options.is_roi_enabled);
+    if (options.depth_range.has_value()) {
+        pipeline.set_depth_gate_enabled(true);
+        pipeline.set_depth_range(options.depth_range->first,
+                                 options.depth_range->second);
+    }
+    if (options.motion_threshold.has_value()) {
+        pipeline.set_motion_gate_enabled(true);
+        pipeline.set_motion_threshold(*options.motion_threshold);
+    }
+    pipeline.start();
 
-    const auto wait_for_frames = [&camera] { return camera.wait_for_frames(); };
+    while (!is_interrupted) {
+        std::this_thread::sleep_for(std::chrono::milliseconds{100});
+    }
+    pipeline.stop();
 
-    auto frames_fut = std::async(std::launch::async, wait_for_frames);
+    LOG_INFO << "Processed " << perf::metrics().get(perf::Counter::Processed)
+             << " frames, failed "
+             << perf::metrics().get(perf::Counter::Failed) << ", dropped "
+             << perf::metrics().get(perf::Counter::CaptureDrops)
+             << " at capture, ran the detector on "
+             << perf::metrics().get(perf::Counter::Keyframes)
+             << ", skipped static "
+             << perf::metrics().get(perf::Counter::GateSkips)
+             << ", pruned out of depth range "
+             << perf::metrics().get(perf::Counter::DepthPruned);
+    return EXIT_SUCCESS;
+}
+
+int run_gui(const Options& options, gui::Application& app,
+            vision::Camera& camera, vision::Pipeline& pipeline,
+            vision::ModelRegistry& registry,
+            const vision::CoreBudget& core_budget) {
+    app.create_video_stream(848, 480, camera.depth_scale());
+    app.setVSync(options.is_vsync_enabled);
+
+    std::vector<std::string> model_names;
+    for (const auto& model : registry.models()) {
+        model_names.push_back(model.name);
+    }
+    auto requested_model = registry.active();
+    app.set_models(std::move(model_names), requested_model);
+
+    pipeline.start();
+    // after starting the pipeline, whose thread would inherit the pinning
+    core_budget.enter_gui_thread();
+
+    // the GUI runs at display refresh and shows whatever the pipeline has
+    // finished last, so slow inference doesn't block input handling
+    std::shared_ptr<const vision::Snapshot> snapshot;
     while (!app.should_close()) {
-        auto frames = frames_fut.get();
-        frames_fut = std::async(std::launch::async, wait_for_frames);
+        const auto cpu_time = perf::ScopedCpuTime{perf::Thread::Gui};
 
-        if (!frames.has_value()) {
-            continue;
+        pipeline.set_inference_enabled(app.is_inference_enabled());
+        pipeline.set_tracking_enabled(app.is_tracking_enabled());
+        pipeline.set_roi_enabled(app.is_roi_enabled());
+        pipeline.set_depth_gate_enabled(app.is_depth_gate_enabled());
+        const auto [depth_min, depth_max] = app.depth_range();
+        pipeline.set_depth_range(depth_min, depth_max);
+        pipeline.set_motion_gate_enabled(app.is_motion_gate_enabled());
+        pipeline.set_motion_threshold(app.motion_threshold());
+        app.update_motion_score(pipeline.motion_score());
+        if (app.selected_model() != requested_model) {
+            requested_model = app.selected_model();
+            registry.request(requested_model);
         }
+        app.update_model_status(registry.active(), registry.loading(),
+                                registry.error());
 
-        if (app.is_inference_enabled()) {
-            detector.input(frames->color());
-            detector.forward();
-            detections = detector.parse(thresholds);
-        } else {
-            detections.clear();
+        if (auto latest = pipeline.latest(); latest != snapshot) {
+            snapshot = std::move(latest);
+            app.update_overlay(snapshot->detections);
+            perf::metrics().add(perf::Counter::Presented);
         }
 
-        static const auto surfaces = std::vector<const cv::Mat*>{
-            &frames->color(), &frames->color_depth()};
-        static std::size_t surface_index = 0;
-        render(camera.depth_scale(), detections, *surfaces[surface_index],
-               frames->depth());
-
         // int k = cv::waitKey(1);
         // if (k == 27 || k == 'q') exit(0);
-        // if (k == 'w') {
-        //     ++surface_index;
-        //     if (surface_index >= surfaces.size()) {
-        //         surface_index = 0;
-        //     }
-        // }
         // if (k == 'c') {
         //     detector.is_nms_class_agnostic = !detector.is_nms_class_agnostic;
         // }
-        // cv::cvtColor(color_bgr, color_bgr, cv::COLOR_BGR2RGB);
-        app.update_video_stream(frames->color().data,
-                                frames->color_depth().data, frames->ir().data);
-        if (const auto depth_picker = app.depth_picker();
-            depth_picker.has_value()) {
-            const auto distance =
-                frames->get_distance(depth_picker->x, depth_picker->y);
-            LOG_INFO << distance;
-            app.update_depth_picker(distance);
+        if (snapshot != nullptr) {
+            const auto& frames = snapshot->frames;
+            app.update_video_stream(frames.color().data,
+                                    frames.depth().ptr<unsigned short>(),
+                                    frames.ir().data, frames.number());
+            if (const auto depth_picker = app.depth_picker();
+                depth_picker.has_value()) {
+                const auto distance =
+                    frames.get_distance(depth_picker->x, depth_picker->y);
+                app.update_depth_picker(distance);
+            }
         }
         app.compose_frame();
         app.render();
 
         app.input();
-        // print_fps();
     }
 
-    return 0;
+    return EXIT_SUCCESS;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    const auto options = parse_options(argc, argv);
+    if (!options.has_value()) {
+        return EXIT_FAILURE;
+    }
+
+    // stdout carries results in the headless mode
+    plog::init<plog::TxtFormatter>(
+        plog::debug,
+        options->is_headless ? plog::streamStdErr : plog::streamStdOut);
+
+    // the models to switch between at runtime, the first is the default
+    auto models = std::vector<vision::ModelSpec>{
+        {.name = "coco",
+         .type = vision::ModelType::YOLOv8,
+         .model_path = "yolov12n.onnx",
+         .labels_path = "coco.names"},
+        {.name = "rps",
+         .type = vision::ModelType::YOLOv8,
+         .model_path = "RPS-12.onnx",
+         .labels_path = "RPS.names"},
+        {.name = "coco-yolov5",
+         .type = vision::ModelType::YOLOv5,
+         .model_path = "yolov5s.onnx",
+         .labels_path = "coco.names"},
+    };
+    for (auto& spec : models) {
+        spec.is_input_dynamic = options->is_input_dynamic;
+    }
+    // one replica for the detector and one per tiled detector
+    auto registry =
+        vision::ModelRegistry(models, 1 + options->tiled_pool_size);
+
+    // Starting the camera, and loading and warming up the models, take
+    // seconds each, so they run in the background while the window is
+    // created. GLFW has to stay on the main thread.
+    auto camera_future = std::async(std::launch::async, [] {
+        auto camera = std::make_unique<vision::Camera>(848, 480, 60);
+        report(perf::Milestone::CameraReady);
+        return camera;
+    });
+    auto models_future = std::async(std::launch::async, [&] {
+        std::vector<std::future<vision::ModelRuntime>> extra_futures;
+        for (const auto& name : options->extra_models) {
+            extra_futures.push_back(std::async(std::launch::async, [&, name] {
+                return registry.make_one(name);
+            }));
+        }
+        LoadedModels loaded;
+        loaded.runtimes =
+            registry.make(options->model.value_or(models[0].name));
+        for (auto& future : extra_futures) {
+            loaded.extra_runtimes.push_back(future.get());
+        }
+        report(perf::Milestone::ModelReady);
+        return loaded;
+    });
+
+    std::unique_ptr<gui::Application> app;
+    if (!options->is_headless) {
+        app = std::make_unique<gui::Application>();
+        if (const auto is_app_ok = app->init(1280, 720, "RealSense Capture");
+            !is_app_ok) {
+            LOG_ERROR << "Couldn't initialize GUI application";
+            return EXIT_FAILURE;
+        }
+        report(perf::Milestone::GuiReady);
+    }
+
+    auto camera = camera_future.get();
+    camera->set_frame_pool_enabled(options->is_frame_pool_enabled);
+    auto [runtimes, extra_runtimes] = models_future.get();
+
+    auto detector = vision::Detector(std::move(runtimes[0]));
+    const auto thresholds = vision::Thresholds{
+        .score = SCORE_THRESH, .nms = NMS_THRESH, .objectness = OBJ_THRESH};
+
+    // outlives the pipeline, whose worker may still be using it
+    std::optional<vision::TiledDetector> tiled_detector;
+    if (options->tiled_pool_size > 0) {
+        std::vector<vision::Detector> pool;
+        for (int i = 0; i < options->tiled_pool_size; ++i) {
+            pool.emplace_back(std::move(runtimes[1 + i]));
+        }
+        tiled_detector.emplace(std::move(pool));
+    }
+
+    // outlive the pipeline too, the multi-model detector runs the detector
+    // and these side by side
+    std::vector<vision::Detector> extra_detectors;
+    for (auto& runtime : extra_runtimes) {
+        extra_detectors.emplace_back(std::move(runtime));
+    }
+    std::optional<vision::MultiDetector> multi_detector;
+    if (!extra_detectors.empty()) {
+        std::vector<vision::Detector*> detectors{&detector};
+        for (auto& extra_detector : extra_detectors) {
+            detectors.push_back(&extra_detector);
+        }
+        multi_detector.emplace(std::move(detectors));
+    }
+
+    // consumers of every snapshot, outlive the pipeline whose callback
+    // feeds them
+    std::optional<vision::ResultsSink> sink;
+    std::optional<vision::ShmPublisher> publisher;
+    std::optional<vision::DetectionLog> detection_log;
+    // an output which can't be opened is a bad option like any other
+    try {
+        if (options->is_headless) {
+            sink.emplace(options->output);
+        }
+        if (options->shm_name.has_value()) {
+            publisher.emplace(*options->shm_name, 848, 480);
+        }
+        if (options->log_path.has_value()) {
+            detection_log.emplace(*options->log_path);
+            // model ids are the multi-model detector's indices
+            detection_log->set_labels(0, detector.labels());
+            for (std::size_t i = 0; i < extra_detectors.size(); ++i) {
+                detection_log->set_labels(static_cast<std::int32_t>(i + 1),
+                                          extra_detectors[i].labels());
+            }
+        }
+    } catch (const std::exception& e) {
+        LOG_ERROR << e.what();
+        return EXIT_FAILURE;
+    }
+
+    const auto core_budget = vision::CoreBudget(options->core_budget);
+    auto pipeline = vision::Pipeline(
+        *camera, detector, thresholds,
+        {.roi = {.input_size = options->roi_size}});
+    if (sink.has_value() || publisher.has_value() ||
+        detection_log.has_value()) {
+        pipeline.set_callback([&, models_version = 0u](
+                                  const vision::Snapshot& snapshot) mutable {
+            if (sink.has_value()) {
+                sink->write(snapshot);
+            }
+            if (publisher.has_value()) {
+                publisher->publish(snapshot);
+            }
+            if (detection_log.has_value()) {
+                // the detector is only swapped on the pipeline thread, which
+                // this runs on
+                if (snapshot.models_version != models_version) {
+                    models_version = snapshot.models_version;
+                    detection_log->set_labels(0, detector.labels());
+                }
+                detection_log->append(snapshot);
+            }
+        });
+    }
+    if (tiled_detector.has_value()) {
+        pipeline.set_tiled_detector(&*tiled_detector);
+    }
+    if (multi_detector.has_value()) {
+        pipeline.set_multi_detector(&*multi_detector);
+    }
+    pipeline.set_model_registry(&registry);
+    pipeline.set_core_budget(&core_budget);
+
+    return options->is_headless
+               ? run_headless(*options, pipeline)
+               : run_gui(*options, *app, *camera, pipeline, registry,
+                         core_budget);
 }
@@ -0,0 +1,38 @@
+#include "allocations.h"
+
+#include <atomic>
+
+namespace {
+
+std::atomic<std::uint64_t> new_count = 0;
+std::atomic<std::uint64_t> new_bytes = 0;
+// trivially constructed, safe to touch from operator new on any thread
+thread_local perf::Allocations thread_counts;
+
+}  // namespace
+
+namespace perf {
+
+Allocations allocations() {
+    return {new_count.load(std::memory_order_relaxed),
+            new_bytes.load(std::memory_order_relaxed)};
+}
+
+Allocations thread_allocations() { return thread_counts; }
+
+namespace detail {
+
+void count_allocation(std::size_t size) {
+    new_count.fetch_add(1, std::memory_order_relaxed);
+    new_bytes.fetch_add(size, std::memory_order_relaxed);
+    count_thread_allocation(size);
+}
+
+void count_thread_allocation(std::size_t size) {
+    ++thread_counts.count;
+    thread_counts.bytes += size;
+}
+
+}  // namespace detail
+
+}  // namespace perf
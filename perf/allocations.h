@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace perf {
+
+// Heap allocations through the global operator new. They are only counted
+// in binaries linked with one of the count_allocations object libraries,
+// which replace operator new: the benchmarks, and the application when
+// built with COUNT_FRAME_ALLOCATIONS, which counts per thread only. Without
+// them the counts stay zero. Allocations OpenCV makes for cv::Mat buffers
+// go through its own allocator and aren't included.
+struct Allocations {
+    std::uint64_t count = 0;
+    std::uint64_t bytes = 0;
+
+    Allocations operator-(const Allocations& other) const {
+        return {count - other.count, bytes - other.bytes};
+    }
+};
+
+// since the start of the process, zero when only threads are counted
+Allocations allocations();
+// made by the calling thread since it started
+Allocations thread_allocations();
+
+namespace detail {
+
+// called by the replacement operator new
+void count_allocation(std::size_t size);
+void count_thread_allocation(std::size_t size);
+
+}  // namespace detail
+
+}  // namespace perf
@@ -0,0 +1,265 @@
+#include "metrics.h"
+
+#include <algorithm>
+#include <cassert>
+#include <ctime>
+
+namespace {
+
+// initialized before main(), close enough to the start of the process
+const auto PROCESS_START = std::chrono::steady_clock::now();
+
+template <typename T>
+std::size_t slot(T value) {
+    assert(value < T::MAX);
+    return static_cast<std::size_t>(value);
+}
+
+}  // namespace
+
+namespace perf {
+
+const char* to_cstr(Stage stage) {
+    switch (stage) {
+        case Stage::Capture:
+            return "capture";
+        case Stage::Align:
+            return "align";
+        case Stage::Copy:
+            return "copy";
+        case Stage::Colorize:
+            return "colorize";
+        case Stage::MotionGate:
+            return "motion gate";
+        case Stage::Preprocess:
+            return "preprocess";
+        case Stage::Forward:
+            return "forward";
+        case Stage::Parse:
+            return "parse";
+        case Stage::DepthGate:
+            return "depth gate";
+        case Stage::Nms:
+            return "nms";
+        case Stage::Track:
+            return "track";
+        case Stage::Depth:
+            return "depth";
+        case Stage::Publish:
+            return "publish";
+        case Stage::Log:
+            return "log";
+        case Stage::Overlay:
+            return "overlay";
+        case Stage::Upload:
+            return "upload";
+        default:
+            return "invalid";
+    }
+}
+
+const char* to_cstr(Counter counter) {
+    switch (counter) {
+        case Counter::Captured:
+            return "captured";
+        case Counter::Processed:
+            return "processed";
+        case Counter::Failed:
+            return "failed";
+        case Counter::Presented:
+            return "presented";
+        case Counter::Keyframes:
+            return "keyframes";
+        case Counter::GatePasses:
+            return "gate passes";
+        case Counter::GateSkips:
+            return "gate skips";
+        case Counter::RoiFrames:
+            return "roi frames";
+        case Counter::InputPixels:
+            return "input pixels";
+        case Counter::DepthSkips:
+            return "depth skips";
+        case Counter::DepthPruned:
+            return "depth pruned";
+        case Counter::CaptureDrops:
+            return "capture drops";
+        case Counter::PresentDrops:
+            return "present drops";
+        case Counter::LogDrops:
+            return "log drops";
+        default:
+            return "invalid";
+    }
+}
+
+const char* to_cstr(Gauge gauge) {
+    switch (gauge) {
+        case Gauge::CaptureQueue:
+            return "capture queue";
+        case Gauge::PresentQueue:
+            return "present queue";
+        case Gauge::PoolSlabs:
+            return "pool slabs";
+        case Gauge::FrameAllocations:
+            return "frame allocations";
+        case Gauge::FrameAllocatedBytes:
+            return "frame allocated bytes";
+        default:
+            return "invalid";
+    }
+}
+
+const char* to_cstr(Thread thread) {
+    switch (thread) {
+        case Thread::Gui:
+            return "gui";
+        case Thread::Pipeline:
+            return "pipeline";
+        case Thread::Capture:
+            return "capture";
+        default:
+            return "invalid";
+    }
+}
+
+const char* to_cstr(Milestone milestone) {
+    switch (milestone) {
+        case Milestone::GuiReady:
+            return "gui ready";
+        case Milestone::CameraReady:
+            return "camera ready";
+        case Milestone::ModelReady:
+            return "model ready";
+        case Milestone::FirstFrame:
+            return "first frame";
+        case Milestone::FirstDetection:
+            return "first detection";
+        default:
+            return "invalid";
+    }
+}
+
+void StageTimings::record(float ms) {
+    const auto i = _count.fetch_add(1, std::memory_order_relaxed);
+    _samples[i % CAPACITY].store(ms, std::memory_order_relaxed);
+}
+
+std::size_t StageTimings::copy(std::array<float, CAPACITY>& out) const {
+    const auto count = _count.load(std::memory_order_relaxed);
+    const auto n = static_cast<std::size_t>(
+        std::min<std::uint64_t>(count, CAPACITY));
+    for (std::size_t k = 0; k < n; ++k) {
+        out[k] = _samples[(count - n + k) % CAPACITY].load(
+            std::memory_order_relaxed);
+    }
+    return n;
+}
+
+void Metrics::record(Stage stage, float ms) {
+    _timings[slot(stage)].record(ms);
+}
+
+const StageTimings& Metrics::timings(Stage stage) const {
+    return _timings[slot(stage)];
+}
+
+void Metrics::add(Counter counter, std::uint64_t value) {
+    _counters[slot(counter)].fetch_add(value, std::memory_order_relaxed);
+}
+
+std::uint64_t Metrics::get(Counter counter) const {
+    return _counters[slot(counter)].load(std::memory_order_relaxed);
+}
+
+void Metrics::set(Gauge gauge, std::int64_t value) {
+    _gauges[slot(gauge)].store(value, std::memory_order_relaxed);
+}
+
+std::int64_t Metrics::get(Gauge gauge) const {
+    return _gauges[slot(gauge)].load(std::memory_order_relaxed);
+}
+
+void Metrics::add_cpu_time(Thread thread, std::chrono::nanoseconds duration) {
+    _cpu_time_ns[slot(thread)].fetch_add(duration.count(),
+                                         std::memory_order_relaxed);
+}
+
+std::chrono::nanoseconds Metrics::cpu_time(Thread thread) const {
+    return std::chrono::nanoseconds{
+        _cpu_time_ns[slot(thread)].load(std::memory_order_relaxed)};
+}
+
+void Metrics::set_enabled(Stage stage, bool flag) {
+    _is_disabled[slot(stage)].store(!flag, std::memory_order_relaxed);
+}
+
+bool Metrics::is_enabled(Stage stage) const {
+    return !is_optional(stage) ||
+           !_is_disabled[slot(stage)].load(std::memory_order_relaxed);
+}
+
+bool Metrics::is_optional(Stage stage) {
+    switch (stage) {
+        case Stage::Align:
+        case Stage::Colorize:
+        case Stage::Nms:
+        case Stage::Depth:
+        case Stage::Overlay:
+        case Stage::Upload:
+            return true;
+        default:
+            return false;
+    }
+}
+
+std::optional<float> Metrics::mark(Milestone milestone) {
+    auto& slot_ns = _milestone_ns[slot(milestone)];
+    // cheap enough for the pipeline to mark every frame
+    if (slot_ns.load(std::memory_order_relaxed) != 0) {
+        return std::nullopt;
+    }
+    const auto ns = std::max<std::int64_t>(
+        1, std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now() - PROCESS_START)
+               .count());
+    auto expected = std::int64_t{0};
+    if (!slot_ns.compare_exchange_strong(expected, ns,
+                                         std::memory_order_relaxed)) {
+        return std::nullopt;
+    }
+    return ns / 1e6f;
+}
+
+std::optional<float> Metrics::since_start(Milestone milestone) const {
+    const auto ns = _milestone_ns[slot(milestone)].load(
+        std::memory_order_relaxed);
+    if (ns == 0) {
+        return std::nullopt;
+    }
+    return ns / 1e6f;
+}
+
+Metrics& metrics() {
+    static Metrics instance;
+    return instance;
+}
+
+std::chrono::nanoseconds thread_cpu_time() {
+    timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return std::chrono::seconds{ts.tv_sec} +
+           std::chrono::nanoseconds{ts.tv_nsec};
+}
+
+ScopedTimer::~ScopedTimer() {
+    const auto duration = std::chrono::duration<float, std::milli>(
+        std::chrono::steady_clock::now() - _tp_before);
+    metrics().record(_stage, duration.count());
+}
+
+ScopedCpuTime::~ScopedCpuTime() {
+    metrics().add_cpu_time(_thread, thread_cpu_time() - _before);
+}
+
+}  // namespace perf
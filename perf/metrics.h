@@ -0,0 +1,195 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <optional>
+
+namespace perf {
+
+enum class Stage {
+    Capture,
+    Align,
+    // copying frames out of librealsense into the frame pool
+    Copy,
+    Colorize,
+    MotionGate,
+    Preprocess,
+    Forward,
+    Parse,
+    DepthGate,
+    Nms,
+    Track,
+    Depth,
+    // copying snapshots into the shared memory ring
+    Publish,
+    // copying detections into the log's columns
+    Log,
+    Overlay,
+    Upload,
+    MAX
+};
+
+enum class Counter {
+    Captured,
+    Processed,
+    // frames the pipeline gave up on after processing them threw
+    Failed,
+    Presented,
+    // processed frames the detector ran on
+    Keyframes,
+    // frames the motion gate let through to the detector or held back
+    GatePasses,
+    GateSkips,
+    // detector runs on crops around earlier detections instead of the frame
+    RoiFrames,
+    // model input pixels of every forward pass, frames, crops and tiles;
+    // what the detector's work scales with
+    InputPixels,
+    // frames, crops or tiles skipped for having no depth in range
+    DepthSkips,
+    // parser candidates dropped for being out of the depth range
+    DepthPruned,
+    // frame numbers skipped by the camera before we got to capture them
+    CaptureDrops,
+    // processed snapshots replaced before the GUI presented them
+    PresentDrops,
+    // detections not logged because the log's writer fell behind
+    LogDrops,
+    MAX
+};
+
+enum class Gauge {
+    // frames already captured and waiting when processing finishes
+    CaptureQueue,
+    // processed snapshots waiting for the GUI
+    PresentQueue,
+    // slabs the camera's frame pool has allocated, frames in flight at most
+    PoolSlabs,
+    // heap allocations processing the latest frame took on the pipeline
+    // thread, plus cv::Mat buffers allocated meanwhile on any thread; the
+    // bytes are without the cv::Mat buffers. Heap allocations are only
+    // counted in COUNT_FRAME_ALLOCATIONS builds.
+    FrameAllocations,
+    FrameAllocatedBytes,
+    MAX
+};
+
+enum class Thread { Gui, Pipeline, Capture, MAX };
+
+// points in startup, timed from the start of the process
+enum class Milestone {
+    // components initialized in parallel
+    GuiReady,
+    CameraReady,
+    ModelReady,
+    FirstFrame,
+    // the first frame the detector ran on, whether it found anything or not
+    FirstDetection,
+    MAX
+};
+
+const char* to_cstr(Stage stage);
+const char* to_cstr(Counter counter);
+const char* to_cstr(Gauge gauge);
+const char* to_cstr(Thread thread);
+const char* to_cstr(Milestone milestone);
+
+// Ring of the latest durations of one stage in milliseconds. Recording is a
+// relaxed fetch_add and a store, readers copy the ring out and may see a
+// sample being overwritten, which is fine for statistics.
+class StageTimings {
+   public:
+    static constexpr std::size_t CAPACITY = 256;
+
+    void record(float ms);
+    // copies samples oldest first, returns how many were copied
+    std::size_t copy(std::array<float, CAPACITY>& out) const;
+
+   private:
+    std::array<std::atomic<float>, CAPACITY> _samples{};
+    std::atomic<std::uint64_t> _count = 0;
+};
+
+class Metrics {
+   public:
+    void record(Stage stage, float ms);
+    const StageTimings& timings(Stage stage) const;
+
+    void add(Counter counter, std::uint64_t value = 1);
+    std::uint64_t get(Counter counter) const;
+
+    void set(Gauge gauge, std::int64_t value);
+    std::int64_t get(Gauge gauge) const;
+
+    void add_cpu_time(Thread thread, std::chrono::nanoseconds duration);
+    std::chrono::nanoseconds cpu_time(Thread thread) const;
+
+    // Stages that can be switched off live to compare their cost. Stages
+    // which are always enabled ignore the flag.
+    void set_enabled(Stage stage, bool flag);
+    bool is_enabled(Stage stage) const;
+    static bool is_optional(Stage stage);
+
+    // milliseconds since the start of the process the first time a milestone
+    // is reached, nullopt on every later call
+    std::optional<float> mark(Milestone milestone);
+    // nullopt until the milestone is reached
+    std::optional<float> since_start(Milestone milestone) const;
+
+   private:
+    std::array<StageTimings, static_cast<std::size_t>(Stage::MAX)> _timings;
+    std::array<std::atomic<std::uint64_t>,
+               static_cast<std::size_t>(Counter::MAX)>
+        _counters{};
+    std::array<std::atomic<std::int64_t>, static_cast<std::size_t>(Gauge::MAX)>
+        _gauges{};
+    std::array<std::atomic<std::int64_t>,
+               static_cast<std::size_t>(Thread::MAX)>
+        _cpu_time_ns{};
+    std::array<std::atomic<bool>, static_cast<std::size_t>(Stage::MAX)>
+        _is_disabled{};
+    // zero until reached
+    std::array<std::atomic<std::int64_t>,
+               static_cast<std::size_t>(Milestone::MAX)>
+        _milestone_ns{};
+};
+
+// process wide metrics shared by the pipeline and the GUI
+Metrics& metrics();
+
+// CPU time consumed by the calling thread so far
+std::chrono::nanoseconds thread_cpu_time();
+
+// Records the wall time of a scope as a stage sample
+class ScopedTimer {
+   public:
+    explicit ScopedTimer(Stage stage)
+        : _stage(stage), _tp_before(std::chrono::steady_clock::now()) {}
+    ~ScopedTimer();
+
+    ScopedTimer(const ScopedTimer&) = delete;
+    ScopedTimer& operator=(const ScopedTimer&) = delete;
+
+   private:
+    Stage _stage;
+    std::chrono::steady_clock::time_point _tp_before;
+};
+
+// Adds the CPU time the calling thread spends in a scope to a thread slot
+class ScopedCpuTime {
+   public:
+    explicit ScopedCpuTime(Thread thread)
+        : _thread(thread), _before(thread_cpu_time()) {}
+    ~ScopedCpuTime();
+
+    ScopedCpuTime(const ScopedCpuTime&) = delete;
+    ScopedCpuTime& operator=(const ScopedCpuTime&) = delete;
+
+   private:
+    Thread _thread;
+    std::chrono::nanoseconds _before;
+};
+
+}  // namespace perf
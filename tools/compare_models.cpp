@@ -0,0 +1,223 @@
+// Runs an FP32 model and its INT8 quantization side by side on a recording
+// and reports how much faster the INT8 one is and how well their detections
+// agree. FP32 detections are the reference: recall is the share of them the
+// INT8 model found, precision the share of INT8 detections FP32 agrees with.
+//
+//   compare_models --fp32 <onnx> --int8 <onnx> --bag <path> [--frames N]
+//                  [--labels <names>] [--type yolov5|yolov8] [--iou T]
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <numeric>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <plog/Formatters/TxtFormatter.h>
+#include <plog/Initializers/ConsoleInitializer.h>
+#include <plog/Log.h>
+
+#include "bench/harness.h"
+#include "vision/camera.h"
+#include "vision/detail/nms.h"
+#include "vision/detector.h"
+#include "vision/factory.h"
+
+namespace {
+
+// frames not timed while caches and the models warm up
+constexpr int WARMUP_FRAMES = 3;
+
+struct Options {
+    std::string fp32_path;
+    std::string int8_path;
+    std::string bag_path;
+    std::string labels_path = "coco.names";
+    vision::ModelType model_type = vision::ModelType::YOLOv8;
+    int frames = 300;
+    // detections of the same class overlapping at least this much match
+    float iou = 0.5f;
+};
+
+std::optional<Options> parse_options(int argc, char** argv) {
+    Options options;
+    for (int i = 1; i < argc; ++i) {
+        const auto arg = std::string_view{argv[i]};
+        const auto has_value = i + 1 < argc;
+        if (arg == "--fp32" && has_value) {
+            options.fp32_path = argv[++i];
+        } else if (arg == "--int8" && has_value) {
+            options.int8_path = argv[++i];
+        } else if (arg == "--bag" && has_value) {
+            options.bag_path = argv[++i];
+        } else if (arg == "--labels" && has_value) {
+            options.labels_path = argv[++i];
+        } else if (arg == "--type" && has_value) {
+            const auto type = bench::parse_model_type(argv[++i]);
+            if (!type.has_value()) {
+                return std::nullopt;
+            }
+            options.model_type = *type;
+        } else if (arg == "--frames" && has_value) {
+            options.frames = std::stoi(argv[++i]);
+        } else if (arg == "--iou" && has_value) {
+            options.iou = std::stof(argv[++i]);
+        } else {
+            std::cerr << "Unknown argument: " << arg << "\n";
+            return std::nullopt;
+        }
+    }
+    if (options.fp32_path.empty() || options.int8_path.empty() ||
+        options.bag_path.empty()) {
+        std::cerr << "Usage: " << argv[0]
+                  << " --fp32 <onnx> --int8 <onnx> --bag <path> [--frames N]\n"
+                     "       [--labels <names>] [--type yolov5|yolov8]"
+                     " [--iou T]\n";
+        return std::nullopt;
+    }
+    return options;
+}
+
+struct Model {
+    vision::Detector detector;
+    std::vector<double> latencies_ms;
+    std::size_t detections = 0;
+};
+
+std::vector<vision::Detection> detect(Model& model, const cv::Mat& color,
+                                      const vision::Thresholds& thresholds,
+                                      bool is_timed) {
+    const auto tp_before = std::chrono::steady_clock::now();
+    model.detector.input(color);
+    model.detector.forward();
+    auto detections = model.detector.parse(thresholds);
+    if (is_timed) {
+        model.latencies_ms.push_back(
+            std::chrono::duration<double, std::milli>(
+                std::chrono::steady_clock::now() - tp_before)
+                .count());
+    }
+    model.detections += detections.size();
+    return detections;
+}
+
+struct Agreement {
+    std::size_t matched = 0;
+    double iou_sum = 0.0;
+};
+
+// greedy matching, the most confident candidates pick first
+Agreement match(const std::vector<vision::Detection>& reference,
+                std::vector<vision::Detection> candidates, float min_iou) {
+    std::sort(candidates.begin(), candidates.end(),
+              [](const auto& a, const auto& b) { return a.score > b.score; });
+
+    Agreement agreement;
+    std::vector<bool> is_taken(reference.size(), false);
+    for (const auto& candidate : candidates) {
+        std::optional<std::size_t> best;
+        auto best_iou = min_iou;
+        for (std::size_t i = 0; i < reference.size(); ++i) {
+            if (is_taken[i] || reference[i].label != candidate.label) {
+                continue;
+            }
+            const auto iou = box_iou(reference[i].box, candidate.box);
+            if (iou >= best_iou) {
+                best = i;
+                best_iou = iou;
+            }
+        }
+        if (best.has_value()) {
+            is_taken[*best] = true;
+            ++agreement.matched;
+            agreement.iou_sum += best_iou;
+        }
+    }
+    return agreement;
+}
+
+double mean(const std::vector<double>& samples) {
+    return samples.empty() ? 0.0
+                           : std::accumulate(samples.begin(), samples.end(),
+                                             0.0) /
+                                 samples.size();
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    const auto options = parse_options(argc, argv);
+    if (!options.has_value()) {
+        return EXIT_FAILURE;
+    }
+
+    plog::init<plog::TxtFormatter>(plog::info, plog::streamStdErr);
+
+    const auto make_model = [&](const std::string& path, auto precision) {
+        return Model{.detector = vision::Detector(vision::make_runtime(
+                         options->model_type, path, options->labels_path, 640,
+                         640, cv::Scalar(114, 114, 114), precision))};
+    };
+    auto fp32 = make_model(options->fp32_path, vision::Precision::FP32);
+    auto int8 = make_model(options->int8_path, vision::Precision::INT8);
+
+    const auto& thresholds = bench::THRESHOLDS;
+
+    auto camera = vision::Camera(options->bag_path);
+    Agreement agreement;
+    int frames_num = 0;
+    while (frames_num < options->frames) {
+        std::optional<vision::Frames> frames;
+        try {
+            frames = camera.wait_for_frames();
+        } catch (const rs2::error&) {
+            // end of the recording
+            break;
+        }
+        if (!frames.has_value()) {
+            continue;
+        }
+
+        const auto is_timed = frames_num >= WARMUP_FRAMES;
+        const auto reference =
+            detect(fp32, frames->color(), thresholds, is_timed);
+        auto candidates = detect(int8, frames->color(), thresholds, is_timed);
+        const auto frame_agreement =
+            match(reference, std::move(candidates), options->iou);
+        agreement.matched += frame_agreement.matched;
+        agreement.iou_sum += frame_agreement.iou_sum;
+        ++frames_num;
+    }
+
+    if (frames_num <= WARMUP_FRAMES) {
+        LOG_ERROR << "Recording has only " << frames_num << " frames";
+        return EXIT_FAILURE;
+    }
+
+    std::printf("%d frames, detection + parse + nms per frame:\n", frames_num);
+    std::printf("%-6s %10s %10s %10s %12s\n", "model", "mean ms", "p50 ms",
+                "p99 ms", "detections");
+    for (const auto& [name, model] :
+         {std::pair<const char*, const Model&>{"fp32", fp32},
+          std::pair<const char*, const Model&>{"int8", int8}}) {
+        std::printf("%-6s %10.2f %10.2f %10.2f %12zu\n", name,
+                    mean(model.latencies_ms),
+                    bench::percentile(model.latencies_ms, 0.5),
+                    bench::percentile(model.latencies_ms, 0.99),
+                    model.detections);
+    }
+
+    const auto ratio = [](double a, double b) { return b > 0.0 ? a / b : 0.0; };
+    std::printf("speedup: %.2fx\n",
+                ratio(mean(fp32.latencies_ms), mean(int8.latencies_ms)));
+    std::printf("recall: %.3f, precision: %.3f at IoU >= %.2f\n",
+                ratio(agreement.matched, fp32.detections),
+                ratio(agreement.matched, int8.detections), options->iou);
+    std::printf("mean IoU of matches: %.3f\n",
+                ratio(agreement.iou_sum, agreement.matched));
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,171 @@
+// Queries a detection log written with `bin --log <path>`. The log is
+// memory mapped and blocks outside the requested frame or time range are
+// skipped by their headers without being decompressed. Matching detections
+// are printed as CSV, or counted per class with --summary.
+//
+//   query_log --log <path> [--frames FIRST LAST] [--time FIRST_MS LAST_MS]
+//             [--class <label>] [--min-score S] [--max-distance M]
+//             [--summary]
+
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <limits>
+#include <map>
+#include <optional>
+#include <string>
+#include <string_view>
+
+#include "vision/detection_log.h"
+
+namespace {
+
+struct Options {
+    std::string log_path;
+    std::uint64_t first_frame = 0;
+    std::uint64_t last_frame = std::numeric_limits<std::uint64_t>::max();
+    double first_ms = -std::numeric_limits<double>::infinity();
+    double last_ms = std::numeric_limits<double>::infinity();
+    std::optional<std::string> label;
+    float min_score = 0.f;
+    std::optional<float> max_distance;
+    bool is_summary = false;
+};
+
+std::optional<Options> parse_options(int argc, char** argv) {
+    Options options;
+    for (int i = 1; i < argc; ++i) {
+        const auto arg = std::string_view{argv[i]};
+        const auto has_value = i + 1 < argc;
+        if (arg == "--log" && has_value) {
+            options.log_path = argv[++i];
+        } else if (arg == "--frames" && i + 2 < argc) {
+            options.first_frame = std::stoull(argv[i + 1]);
+            options.last_frame = std::stoull(argv[i + 2]);
+            i += 2;
+        } else if (arg == "--time" && i + 2 < argc) {
+            options.first_ms = std::stod(argv[i + 1]);
+            options.last_ms = std::stod(argv[i + 2]);
+            i += 2;
+        } else if (arg == "--class" && has_value) {
+            options.label = argv[++i];
+        } else if (arg == "--min-score" && has_value) {
+            options.min_score = std::stof(argv[++i]);
+        } else if (arg == "--max-distance" && has_value) {
+            options.max_distance = std::stof(argv[++i]);
+        } else if (arg == "--summary") {
+            options.is_summary = true;
+        } else {
+            std::cerr << "Unknown argument: " << arg << "\n";
+            return std::nullopt;
+        }
+    }
+    if (options.log_path.empty()) {
+        std::cerr << "Usage: " << argv[0]
+                  << " --log <path> [--frames FIRST LAST]"
+                     " [--time FIRST_MS LAST_MS]\n"
+                     "       [--class <label>] [--min-score S]"
+                     " [--max-distance M] [--summary]\n";
+        return std::nullopt;
+    }
+    return options;
+}
+
+// the labels the model had when the block was written
+std::string label_of(const vision::DetectionLogReader& log,
+                     const vision::DetectionLogReader::Block& block,
+                     int class_id, int model_id) {
+    const auto& labels = log.labels(block, model_id);
+    if (class_id >= 0 && static_cast<std::size_t>(class_id) < labels.size()) {
+        return labels[class_id];
+    }
+    if (model_id > 0) {
+        return "model " + std::to_string(model_id) + " class " +
+               std::to_string(class_id);
+    }
+    return std::to_string(class_id);
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    const auto options = parse_options(argc, argv);
+    if (!options.has_value()) {
+        return EXIT_FAILURE;
+    }
+
+    try {
+        const auto log = vision::DetectionLogReader(options->log_path);
+
+        if (!options->is_summary) {
+            std::printf(
+                "frame,timestamp,label,track,model,score,x,y,width,height,"
+                "distance,depth_min,depth_max,position_x,position_y,"
+                "position_z\n");
+        }
+
+        std::map<std::string, std::size_t> counts;
+        std::size_t blocks_read = 0;
+        vision::DetectionColumns columns;
+        for (const auto& block : log.blocks()) {
+            const auto& header = block.header;
+            if (header.last_frame < options->first_frame ||
+                header.first_frame > options->last_frame ||
+                header.last_timestamp < options->first_ms ||
+                header.first_timestamp > options->last_ms) {
+                continue;
+            }
+            log.read(block, columns);
+            ++blocks_read;
+
+            for (std::size_t i = 0; i < columns.size(); ++i) {
+                if (columns.frame[i] < options->first_frame ||
+                    columns.frame[i] > options->last_frame ||
+                    columns.timestamp[i] < options->first_ms ||
+                    columns.timestamp[i] > options->last_ms ||
+                    columns.score[i] < options->min_score) {
+                    continue;
+                }
+                // unknown distances never pass a distance limit
+                if (options->max_distance.has_value() &&
+                    !(columns.distance[i] <= *options->max_distance)) {
+                    continue;
+                }
+                const auto label = label_of(log, block, columns.class_id[i],
+                                            columns.model_id[i]);
+                if (options->label.has_value() && label != *options->label) {
+                    continue;
+                }
+
+                if (options->is_summary) {
+                    ++counts[label];
+                    continue;
+                }
+                std::printf(
+                    "%llu,%.3f,%s,%d,%d,%.3f,%d,%d,%d,%d,%.3f,%.3f,%.3f,%.3f,"
+                    "%.3f,%.3f\n",
+                    static_cast<unsigned long long>(columns.frame[i]),
+                    columns.timestamp[i], label.c_str(), columns.track_id[i],
+                    columns.model_id[i], columns.score[i], columns.x[i],
+                    columns.y[i], columns.width[i], columns.height[i],
+                    columns.distance[i],
+                    columns.depth_min[i], columns.depth_max[i],
+                    columns.position_x[i], columns.position_y[i],
+                    columns.position_z[i]);
+            }
+        }
+
+        if (options->is_summary) {
+            std::printf("%zu of %zu blocks read\n", blocks_read,
+                        log.blocks().size());
+            for (const auto& [label, count] : counts) {
+                std::printf("%-20s %10zu\n", label.c_str(), count);
+            }
+        }
+    } catch (const std::runtime_error& e) {
+        std::cerr << e.what() << "\n";
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,142 @@
+// Follows a shared memory ring published with `bin --shm <name>` from
+// another process and prints the frames and detections it sees, reading
+// them in place. Exits non-zero when it doesn't get the requested number of
+// frames in time, so it doubles as a check that publishing works.
+//
+//   shm_reader --name <ring> [--frames N] [--timeout S] [--quiet]
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+
+#include "ipc/reader.h"
+
+namespace {
+
+struct Options {
+    std::string name;
+    // 0 runs until the timeout
+    int frames = 0;
+    float timeout_s = 10.f;
+    bool is_quiet = false;
+};
+
+std::optional<Options> parse_options(int argc, char** argv) {
+    Options options;
+    for (int i = 1; i < argc; ++i) {
+        const auto arg = std::string_view{argv[i]};
+        const auto has_value = i + 1 < argc;
+        if (arg == "--name" && has_value) {
+            options.name = argv[++i];
+        } else if (arg == "--frames" && has_value) {
+            options.frames = std::stoi(argv[++i]);
+        } else if (arg == "--timeout" && has_value) {
+            options.timeout_s = std::stof(argv[++i]);
+        } else if (arg == "--quiet") {
+            options.is_quiet = true;
+        } else {
+            std::cerr << "Unknown argument: " << arg << "\n";
+            return std::nullopt;
+        }
+    }
+    if (options.name.empty()) {
+        std::cerr << "Usage: " << argv[0]
+                  << " --name <ring> [--frames N] [--timeout S] [--quiet]\n";
+        return std::nullopt;
+    }
+    return options;
+}
+
+// depth at the image center in meters, 0 if there is none
+float center_distance(const ipc::RingReader& ring,
+                      const ipc::FrameView& view) {
+    const auto x = ring.width() / 2;
+    const auto y = ring.height() / 2;
+    return view.depth[y * ring.width() + x] * view.frame->depth_scale;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    const auto options = parse_options(argc, argv);
+    if (!options.has_value()) {
+        return EXIT_FAILURE;
+    }
+
+    const auto deadline =
+        std::chrono::steady_clock::now() +
+        std::chrono::duration<float>(options->timeout_s);
+
+    // the writer may not have created the ring yet
+    std::optional<ipc::RingReader> ring;
+    while (!ring.has_value()) {
+        try {
+            ring.emplace(options->name);
+        } catch (const std::runtime_error& e) {
+            if (std::chrono::steady_clock::now() > deadline) {
+                std::cerr << e.what() << "\n";
+                return EXIT_FAILURE;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds{50});
+        }
+    }
+
+    int frames_num = 0;
+    int torn_num = 0;
+    std::uint64_t skipped_num = 0;
+    std::optional<std::uint64_t> last_number;
+    while (options->frames == 0 || frames_num < options->frames) {
+        if (std::chrono::steady_clock::now() > deadline) {
+            break;
+        }
+        const auto view = ring->latest();
+        if (!view.has_value() || view->frame->number == last_number) {
+            std::this_thread::sleep_for(std::chrono::milliseconds{1});
+            continue;
+        }
+
+        const auto number = view->frame->number;
+        const auto distance = center_distance(*ring, *view);
+        // bounded, a torn read may see anything
+        const auto detections_num = std::min<std::size_t>(
+            view->frame->detections_num, ipc::MAX_DETECTIONS);
+        std::string labels;
+        for (std::size_t i = 0; i < detections_num; ++i) {
+            const auto& label = view->detections[i].label;
+            labels += (i == 0 ? "" : ", ");
+            labels.append(label, strnlen(label, ipc::LABEL_SIZE));
+        }
+        // whatever was read above is garbage if the writer got into the slot
+        if (!ring->is_valid(*view)) {
+            ++torn_num;
+            continue;
+        }
+
+        if (last_number.has_value() && number > *last_number + 1) {
+            skipped_num += number - *last_number - 1;
+        }
+        last_number = number;
+        ++frames_num;
+        if (!options->is_quiet) {
+            std::printf("frame %llu, center %.3f m, %zu detections: %s\n",
+                        static_cast<unsigned long long>(number), distance,
+                        detections_num, labels.c_str());
+        }
+    }
+
+    std::printf("read %d frames, skipped %llu, discarded %d torn reads\n",
+                frames_num, static_cast<unsigned long long>(skipped_num),
+                torn_num);
+    return options->frames == 0 || frames_num >= options->frames
+               ? EXIT_SUCCESS
+               : EXIT_FAILURE;
+}
@@ -0,0 +1,226 @@
+// Publishes synthetic frames into a shared memory ring, without a camera or
+// OpenCV. Every frame's depth scale, depth plane and detection labels follow
+// from its number, so with --reader it runs shm_reader on the ring, keeps
+// publishing until the reader is done and checks that every frame the reader
+// printed round-tripped. Exits non-zero when one didn't or the reader failed.
+//
+//   shm_writer --name <ring> [--frames N] [--interval MS]
+//              [--reader <shm_reader>]
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+
+#include "ipc/writer.h"
+
+namespace {
+
+constexpr std::uint32_t WIDTH = 64;
+constexpr std::uint32_t HEIGHT = 48;
+constexpr std::uint32_t SLOTS_NUM = 4;
+// far from 0 so numbers that don't round-trip can't pass by accident
+constexpr std::uint64_t FIRST_NUMBER = 1000;
+constexpr std::uint16_t DEPTH = 4000;
+
+struct Options {
+    std::string name;
+    // frames to publish, or the reader has to read
+    int frames = 100;
+    int interval_ms = 2;
+    std::string reader_path;
+};
+
+std::optional<Options> parse_options(int argc, char** argv) {
+    Options options;
+    for (int i = 1; i < argc; ++i) {
+        const auto arg = std::string_view{argv[i]};
+        const auto has_value = i + 1 < argc;
+        if (arg == "--name" && has_value) {
+            options.name = argv[++i];
+        } else if (arg == "--frames" && has_value) {
+            options.frames = std::stoi(argv[++i]);
+        } else if (arg == "--interval" && has_value) {
+            options.interval_ms = std::stoi(argv[++i]);
+        } else if (arg == "--reader" && has_value) {
+            options.reader_path = argv[++i];
+        } else {
+            std::cerr << "Unknown argument: " << arg << "\n";
+            return std::nullopt;
+        }
+    }
+    if (options.name.empty() || options.frames <= 0) {
+        std::cerr << "Usage: " << argv[0]
+                  << " --name <ring> [--frames N] [--interval MS]"
+                     " [--reader <shm_reader>]\n";
+        return std::nullopt;
+    }
+    return options;
+}
+
+float depth_scale_of(std::uint64_t number) {
+    return 0.00025f * static_cast<float>(1 + number % 4);
+}
+
+std::size_t detections_num_of(std::uint64_t number) { return number % 4; }
+
+std::string label_of(std::uint64_t number, std::size_t i) {
+    return "obj" + std::to_string(number) + "_" + std::to_string(i);
+}
+
+// the labels as shm_reader prints them
+std::string labels_of(std::uint64_t number) {
+    std::string labels;
+    for (std::size_t i = 0; i < detections_num_of(number); ++i) {
+        labels += (i == 0 ? "" : ", ") + label_of(number, i);
+    }
+    return labels;
+}
+
+void publish(ipc::RingWriter& ring, std::uint64_t number) {
+    auto slot = ring.begin();
+    const auto pixels = std::size_t{WIDTH} * HEIGHT;
+    std::memset(slot.color, static_cast<int>(number % 256), pixels * 3);
+    std::fill_n(slot.depth, pixels, DEPTH);
+    std::memset(slot.ir, static_cast<int>(number % 256), pixels);
+
+    const auto detections_num = detections_num_of(number);
+    for (std::size_t i = 0; i < detections_num; ++i) {
+        auto& record = slot.detections[i];
+        record = ipc::DetectionRecord{.class_id = static_cast<std::int32_t>(i),
+                                      .track_id = -1,
+                                      .score = 0.5f,
+                                      .distance = NAN,
+                                      .x = 0,
+                                      .y = 0,
+                                      .width = 1,
+                                      .height = 1,
+                                      .label = {}};
+        const auto label = label_of(number, i);
+        std::strncpy(record.label, label.c_str(), ipc::LABEL_SIZE - 1);
+    }
+    slot.frame = ipc::FrameHeader{
+        .number = number,
+        .timestamp = static_cast<double>(number),
+        .depth_scale = depth_scale_of(number),
+        .is_keyframe = 1,
+        .intrinsics = {.width = WIDTH, .height = HEIGHT},
+        .detections_num = static_cast<std::uint32_t>(detections_num)};
+    ring.commit();
+}
+
+// checks a frame line against what was published, reports what's off
+bool check_frame_line(const std::string& line) {
+    unsigned long long number = 0;
+    float distance = 0.f;
+    std::size_t detections_num = 0;
+    int labels_at = 0;
+    if (std::sscanf(line.c_str(), "frame %llu, center %f m, %zu detections: %n",
+                    &number, &distance, &detections_num, &labels_at) != 3 ||
+        labels_at == 0) {
+        std::cerr << "Unexpected reader output: " << line;
+        return false;
+    }
+    auto labels = line.substr(labels_at);
+    if (!labels.empty() && labels.back() == '\n') {
+        labels.pop_back();
+    }
+
+    const auto expected_distance = DEPTH * depth_scale_of(number);
+    // printed with three decimals
+    const auto is_distance_ok = std::abs(distance - expected_distance) < 1e-3f;
+    const auto is_ok = number >= FIRST_NUMBER && is_distance_ok &&
+                       detections_num == detections_num_of(number) &&
+                       labels == labels_of(number);
+    if (!is_ok) {
+        std::cerr << "Frame " << number
+                  << " didn't round-trip, expected center "
+                  << expected_distance << " m and labels \""
+                  << labels_of(number) << "\", read: " << line;
+    }
+    return is_ok;
+}
+
+int run_reader(const Options& options, ipc::RingWriter& ring) {
+    auto is_reader_done = std::atomic<bool>{false};
+    auto publisher = std::thread([&] {
+        // the reader only sees the newest frame, so it keeps going until the
+        // reader read as many as it wanted, or gave up
+        for (auto number = FIRST_NUMBER; !is_reader_done; ++number) {
+            publish(ring, number);
+            std::this_thread::sleep_for(
+                std::chrono::milliseconds{options.interval_ms});
+        }
+    });
+
+    const auto command = "'" + options.reader_path + "' --name '" +
+                         options.name + "' --frames " +
+                         std::to_string(options.frames);
+    auto* pipe = popen(command.c_str(), "r");
+    if (pipe == nullptr) {
+        is_reader_done = true;
+        publisher.join();
+        std::cerr << "Failed to run " << command << "\n";
+        return EXIT_FAILURE;
+    }
+
+    int frames_num = 0;
+    int mismatches = 0;
+    char line[1024];
+    while (std::fgets(line, sizeof(line), pipe) != nullptr) {
+        // the reader's summary and anything else that isn't a frame
+        if (std::strncmp(line, "frame ", 6) != 0) {
+            std::fputs(line, stdout);
+            continue;
+        }
+        ++frames_num;
+        mismatches += !check_frame_line(line);
+    }
+    const auto status = pclose(pipe);
+    is_reader_done = true;
+    publisher.join();
+
+    std::printf("checked %d frames, %d didn't round-trip\n", frames_num,
+                mismatches);
+    if (status != 0) {
+        std::cerr << "Reader failed with status " << status << "\n";
+        return EXIT_FAILURE;
+    }
+    return frames_num >= options.frames && mismatches == 0 ? EXIT_SUCCESS
+                                                           : EXIT_FAILURE;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    const auto options = parse_options(argc, argv);
+    if (!options.has_value()) {
+        return EXIT_FAILURE;
+    }
+
+    try {
+        auto ring = ipc::RingWriter(options->name, WIDTH, HEIGHT, SLOTS_NUM);
+        if (!options->reader_path.empty()) {
+            return run_reader(*options, ring);
+        }
+        for (int i = 0; i < options->frames; ++i) {
+            publish(ring, FIRST_NUMBER + i);
+            std::this_thread::sleep_for(
+                std::chrono::milliseconds{options->interval_ms});
+        }
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << "\n";
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
@@ -4,6 +4,8 @@
 
 #include <chrono>
 
+#include "perf/metrics.h"
+
 namespace {
 
 float get_depth_scale(const std::optional<rs2::depth_sensor>& sensor) {
@@ -15,6 +17,18 @@ float get_depth_scale(const std::optional<rs2::depth_sensor>& sensor) {
     }
 }
 
+// once per stream, asking every frame's profile would query the device
+rs2_intrinsics get_color_intrinsics(const rs2::pipeline_profile& profile) {
+    try {
+        return profile.get_stream(RS2_STREAM_COLOR)
+            .as<rs2::video_stream_profile>()
+            .get_intrinsics();
+    } catch (const rs2::error& e) {
+        LOG_WARNING << "Failed to get color intrinsics: " << e.what();
+        return {};
+    }
+}
+
 template <typename T>
 std::optional<T> get_sensor(const rs2::pipeline_profile& profile) {
     try {
@@ -54,45 +68,106 @@ cv::Mat normalize_u16_to_rgb(cv::Mat&& mat) {
     return rgb;
 }
 
-inline cv::Mat gray_to_rgb(cv::Mat&& mat) {
-    cv::Mat rgb;
-    cv::cvtColor(mat, rgb, cv::COLOR_GRAY2RGB);
-    return rgb;
-}
-
 }  // namespace
 
 namespace vision {
 
 Frames::Frames(rs2::video_frame color_frame, rs2::depth_frame depth_frame,
-               rs2::video_frame depth_color_frame, rs2::video_frame ir_frame)
-    : _color_frame(std::move(color_frame)),
-      _depth_frame(std::move(depth_frame)),
-      _depth_color_frame(std::move(depth_color_frame)),
-      _ir_frame(std::move(ir_frame)) {
+               rs2::video_frame ir_frame, const rs2_intrinsics& intrinsics)
+    : _depth_scale(depth_frame.get_units()),
+      _intrinsics(intrinsics),
+      _number(color_frame.get_frame_number()),
+      _timestamp(color_frame.get_timestamp()) {
     // _color_bgr = frame_to_mat(_color_frame, CV_8UC3);
 
     _color_bgr =
-        cv::Mat(_color_frame.get_height(), _color_frame.get_width(), CV_8UC3,
-                (void*)_color_frame.get_data(), cv::Mat::AUTO_STEP);
+        cv::Mat(color_frame.get_height(), color_frame.get_width(), CV_8UC3,
+                (void*)color_frame.get_data(), cv::Mat::AUTO_STEP);
     if (!_color_bgr.isContinuous()) {
         _color_bgr = _color_bgr.clone();
     }
-    _depth_z16 = frame_to_mat(_depth_frame, CV_16U);
-    _depth_rgb = frame_to_mat(_depth_color_frame, CV_8UC3);
-    _ir_y8 = gray_to_rgb(frame_to_mat(_ir_frame, CV_8UC1));
+    _depth_z16 = frame_to_mat(depth_frame, CV_16U);
+    _ir_y8 = frame_to_mat(ir_frame, CV_8UC1);
+
+    _color_frame = std::move(color_frame);
+    _depth_frame = std::move(depth_frame);
+    _ir_frame = std::move(ir_frame);
 }
 
-const cv::Mat& Frames::color() const { return _color_bgr; }
+Frames::Frames(cv::Mat color_bgr, cv::Mat depth_z16, cv::Mat ir_y8,
+               float depth_scale, unsigned long long number, double timestamp,
+               const rs2_intrinsics& intrinsics)
+    : _color_bgr(std::move(color_bgr)),
+      _depth_z16(std::move(depth_z16)),
+      _ir_y8(std::move(ir_y8)),
+      _depth_scale(depth_scale),
+      _intrinsics(intrinsics),
+      _number(number),
+      _timestamp(timestamp) {}
+
+Frames::Frames(FrameBuffer buffer, cv::Mat color_bgr, cv::Mat depth_z16,
+               cv::Mat ir_y8, float depth_scale, unsigned long long number,
+               double timestamp, const rs2_intrinsics& intrinsics)
+    : Frames(std::move(color_bgr), std::move(depth_z16), std::move(ir_y8),
+             depth_scale, number, timestamp, intrinsics) {
+    _buffer = std::move(buffer);
+}
 
-const cv::Mat& Frames::color_depth() const { return _depth_rgb; }
+const cv::Mat& Frames::color() const { return _color_bgr; }
 
 const cv::Mat& Frames::depth() const { return _depth_z16; }
 
 const cv::Mat& Frames::ir() const { return _ir_y8; }
 
 float Frames::get_distance(int x, int y) const {
-    return _depth_frame.get_distance(x, y);
+    if (x < 0 || y < 0 || x >= _depth_z16.cols || y >= _depth_z16.rows) {
+        return 0.f;
+    }
+    return _depth_z16.at<uint16_t>(y, x) * _depth_scale;
+}
+
+float Frames::depth_scale() const { return _depth_scale; }
+
+const rs2_intrinsics& Frames::intrinsics() const { return _intrinsics; }
+
+unsigned long long Frames::number() const { return _number; }
+
+double Frames::timestamp() const { return _timestamp; }
+
+std::size_t frames_slab_size(const cv::Mat& color_bgr,
+                             const cv::Mat& depth_z16, const cv::Mat& ir_y8) {
+    const auto plane_size = [](const cv::Mat& mat) {
+        return align_frame(mat.total() * mat.elemSize());
+    };
+    return plane_size(color_bgr) + plane_size(depth_z16) + plane_size(ir_y8);
+}
+
+Frames copy_to_pool(FramePool& pool, const cv::Mat& color_bgr,
+                    const cv::Mat& depth_z16, const cv::Mat& ir_y8,
+                    float depth_scale, unsigned long long number,
+                    double timestamp, const rs2_intrinsics& intrinsics) {
+    const auto depth_offset =
+        align_frame(color_bgr.total() * color_bgr.elemSize());
+    const auto ir_offset =
+        depth_offset + align_frame(depth_z16.total() * depth_z16.elemSize());
+
+    auto buffer = pool.acquire();
+    auto color = cv::Mat(color_bgr.size(), CV_8UC3, buffer.data());
+    auto depth =
+        cv::Mat(depth_z16.size(), CV_16U, buffer.data() + depth_offset);
+    auto ir = cv::Mat(ir_y8.size(), CV_8UC1, buffer.data() + ir_offset);
+    color_bgr.copyTo(color);
+    depth_z16.copyTo(depth);
+    ir_y8.copyTo(ir);
+
+    return Frames{std::move(buffer),
+                  std::move(color),
+                  std::move(depth),
+                  std::move(ir),
+                  depth_scale,
+                  number,
+                  timestamp,
+                  intrinsics};
 }
 
 Camera::Camera(int width, int height, int fps)
@@ -105,30 +180,93 @@ Camera::Camera(int width, int height, int fps)
     _profile = _pipe.start(cfg);
     _depth_sensor = get_sensor<rs2::depth_sensor>(_profile);
     _depth_scale = get_depth_scale(_depth_sensor);
+    _color_intrinsics = get_color_intrinsics(_profile);
+}
+
+Camera::Camera(const std::string& bag_path)
+    : _align_to_color(RS2_STREAM_COLOR) {
+    rs2::config cfg;
+    cfg.enable_device_from_file(bag_path, false);
+    _profile = _pipe.start(cfg);
+    if (auto playback = _profile.get_device().as<rs2::playback>()) {
+        playback.set_real_time(false);
+    }
+    _depth_sensor = get_sensor<rs2::depth_sensor>(_profile);
+    _depth_scale = get_depth_scale(_depth_sensor);
+    _color_intrinsics = get_color_intrinsics(_profile);
 }
 
 Camera::~Camera() { _pipe.stop(); }
 
 std::optional<Frames> Camera::wait_for_frames() {
-    const auto frames = _pipe.wait_for_frames();
-    const auto aligned_frames = _align_to_color.process(frames);
+    const auto cpu_time = perf::ScopedCpuTime{perf::Thread::Capture};
 
-    auto color = aligned_frames.get_color_frame();
-    auto depth = aligned_frames.get_depth_frame();
-    auto ir = aligned_frames.get_infrared_frame();
+    rs2::frameset frames;
+    {
+        const auto timer = perf::ScopedTimer{perf::Stage::Capture};
+        frames = _pipe.wait_for_frames();
+    }
+    if (perf::metrics().is_enabled(perf::Stage::Align)) {
+        const auto timer = perf::ScopedTimer{perf::Stage::Align};
+        frames = _align_to_color.process(frames);
+    }
+
+    auto color = frames.get_color_frame();
+    auto depth = frames.get_depth_frame();
+    auto ir = frames.get_infrared_frame();
 
     if (!color || !depth || !ir) {
         return std::nullopt;
     }
 
-    auto depth_colorized = _colorizer.process(depth);
+    perf::metrics().add(perf::Counter::Captured);
+    const auto frame_number = color.get_frame_number();
+    if (_last_frame_number.has_value() &&
+        frame_number > *_last_frame_number + 1) {
+        perf::metrics().add(perf::Counter::CaptureDrops,
+                            frame_number - *_last_frame_number - 1);
+    }
+    _last_frame_number = frame_number;
 
-    return Frames{std::move(color), std::move(depth),
-                  std::move(depth_colorized), std::move(ir)};
+    if (_is_pooled) {
+        return copy_to_pool(color, depth, ir);
+    }
+    return Frames{std::move(color), std::move(depth), std::move(ir),
+                  _color_intrinsics};
 }
 
 float Camera::depth_scale() const { return _depth_scale; }
 
+void Camera::set_frame_pool_enabled(bool flag) { _is_pooled = flag; }
+
+Frames Camera::copy_to_pool(const rs2::video_frame& color,
+                            const rs2::depth_frame& depth,
+                            const rs2::video_frame& ir) {
+    const auto timer = perf::ScopedTimer{perf::Stage::Copy};
+
+    const auto to_mat = [](const rs2::video_frame& frame, int type) {
+        return cv::Mat(frame.get_height(), frame.get_width(), type,
+                       const_cast<void*>(frame.get_data()),
+                       frame.get_stride_in_bytes());
+    };
+    const auto color_src = to_mat(color, CV_8UC3);
+    const auto depth_src = to_mat(depth, CV_16U);
+    const auto ir_src = to_mat(ir, CV_8UC1);
+
+    const auto slab_size = frames_slab_size(color_src, depth_src, ir_src);
+    if (!_pool.has_value() || _pool->slab_size() < slab_size) {
+        // buffers still held keep their slabs of the old pool
+        _pool.emplace(slab_size);
+    }
+
+    auto frames = vision::copy_to_pool(
+        *_pool, color_src, depth_src, ir_src, depth.get_units(),
+        color.get_frame_number(), color.get_timestamp(), _color_intrinsics);
+    perf::metrics().set(perf::Gauge::PoolSlabs,
+                        static_cast<std::int64_t>(_pool->slabs_num()));
+    return frames;
+}
+
 std::optional<float> Camera::get_exposure() const {
     return get_option(RS2_OPTION_EXPOSURE);
 }
@@ -1,41 +1,97 @@
 #pragma once
 
+#include <atomic>
+
 #include <librealsense2/rs.hpp>
 #include <opencv2/opencv.hpp>
 
+#include "frame_pool.h"
+
 namespace vision {
 
 class Frames {
    public:
+    // wraps the librealsense frames without copying, they are kept alive as
+    // long as the Frames
     Frames(rs2::video_frame color_bgr, rs2::depth_frame depth_z16,
-           rs2::video_frame depth_rgb, rs2::video_frame ir_y8);
+           rs2::video_frame ir_y8, const rs2_intrinsics& intrinsics);
+    // frames which don't come from a camera, e.g. synthetic or replayed
+    Frames(cv::Mat color_bgr, cv::Mat depth_z16, cv::Mat ir_y8,
+           float depth_scale, unsigned long long number, double timestamp,
+           const rs2_intrinsics& intrinsics = {});
+    // frames copied into a pooled buffer, which the mats point into and
+    // which is held as long as the Frames
+    Frames(FrameBuffer buffer, cv::Mat color_bgr, cv::Mat depth_z16,
+           cv::Mat ir_y8, float depth_scale, unsigned long long number,
+           double timestamp, const rs2_intrinsics& intrinsics);
 
     const cv::Mat& color() const;
-    const cv::Mat& color_depth() const;
     const cv::Mat& depth() const;
     const cv::Mat& ir() const;
 
     float get_distance(int x, int y) const;
+    float depth_scale() const;
+    // of the color stream, which depth is aligned to; zero for frames
+    // without a camera
+    const rs2_intrinsics& intrinsics() const;
+    unsigned long long number() const;
+    // milliseconds, as reported by librealsense
+    double timestamp() const;
 
    private:
-    rs2::video_frame _color_frame;
-    rs2::depth_frame _depth_frame;
-    rs2::video_frame _depth_color_frame;
-    rs2::video_frame _ir_frame;
+    rs2::frame _color_frame;
+    rs2::frame _depth_frame;
+    rs2::frame _ir_frame;
+    FrameBuffer _buffer;
 
     cv::Mat _color_bgr;
     cv::Mat _depth_z16;
-    cv::Mat _depth_rgb;
     cv::Mat _ir_y8;
+
+    float _depth_scale;
+    rs2_intrinsics _intrinsics;
+    unsigned long long _number;
+    double _timestamp;
+};
+
+// one slab holding the color, depth and infrared images, each starting at an
+// aligned offset
+std::size_t frames_slab_size(const cv::Mat& color_bgr,
+                             const cv::Mat& depth_z16, const cv::Mat& ir_y8);
+// copies the images, which may have padded rows, into a slab of the pool of
+// at least frames_slab_size
+Frames copy_to_pool(FramePool& pool, const cv::Mat& color_bgr,
+                    const cv::Mat& depth_z16, const cv::Mat& ir_y8,
+                    float depth_scale, unsigned long long number,
+                    double timestamp, const rs2_intrinsics& intrinsics);
+
+// Where the pipeline gets frames from: a live camera, a recording or a
+// generator
+class FrameSource {
+   public:
+    virtual ~FrameSource() = default;
+
+    // nullopt when a frameset was incomplete or the source has run out
+    virtual std::optional<Frames> wait_for_frames() = 0;
+    virtual float depth_scale() const = 0;
 };
 
-class Camera {
+class Camera : public FrameSource {
    public:
     Camera(int width, int height, int fps);
-    ~Camera();
+    // plays a .bag recording back as fast as it is consumed; the recording
+    // needs BGR8 color, Z16 depth and Y8 infrared streams
+    explicit Camera(const std::string& bag_path);
+    ~Camera() override;
 
-    std::optional<Frames> wait_for_frames();
-    float depth_scale() const;
+    std::optional<Frames> wait_for_frames() override;
+    float depth_scale() const override;
+
+    // Copies every frameset into a slab of a frame pool and releases the
+    // librealsense frames right away, so slow processing doesn't starve
+    // librealsense of buffers and drop frames at the source. Costs a copy
+    // of each frame.
+    void set_frame_pool_enabled(bool flag);
 
     std::optional<float> get_exposure() const;
     void set_exposure(float exposure);
@@ -44,12 +100,20 @@ class Camera {
     void set_option(rs2_option, float);
 
    private:
+    Frames copy_to_pool(const rs2::video_frame& color,
+                        const rs2::depth_frame& depth,
+                        const rs2::video_frame& ir);
+
     rs2::pipeline _pipe;
     rs2::pipeline_profile _profile;
     std::optional<rs2::depth_sensor> _depth_sensor;
     rs2::align _align_to_color;
-    rs2::colorizer _colorizer;
     float _depth_scale = 0.01f;
+    rs2_intrinsics _color_intrinsics{};
+    std::optional<unsigned long long> _last_frame_number;
+    std::atomic<bool> _is_pooled = false;
+    // capture thread only, sized by the first pooled frameset
+    std::optional<FramePool> _pool;
 };
 
 }  // namespace vision
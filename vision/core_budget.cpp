@@ -0,0 +1,164 @@
+#include "core_budget.h"
+
+#include <pthread.h>
+#include <sched.h>
+
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+#include <stdexcept>
+
+#include <opencv2/core/utility.hpp>
+#include <plog/Log.h>
+
+namespace {
+
+// cores a thread can be pinned to, a cpu_set_t holds no more; also keeps
+// ranges such as 0-2000000000 from being expanded
+#ifdef __linux__
+constexpr int MAX_CORES = CPU_SETSIZE;
+#else
+constexpr int MAX_CORES = 1024;
+#endif
+
+int parse_core(std::string_view text, std::string_view list) {
+    int core = -1;
+    const auto [end, error] =
+        std::from_chars(text.data(), text.data() + text.size(), core);
+    if (error != std::errc{} || end != text.data() + text.size() || core < 0 ||
+        core >= MAX_CORES) {
+        throw std::invalid_argument{"Invalid core list: " + std::string{list}};
+    }
+    return core;
+}
+
+}  // namespace
+
+namespace vision {
+
+CoreBudget::CoreBudget(CoreBudgetConfig config) : _config(std::move(config)) {}
+
+void CoreBudget::enter_inference_thread() const {
+    pin(_config.inference_cores);
+    const auto cv_threads =
+        _config.cv_threads > 0 ? _config.cv_threads : cv::getNumThreads();
+    if (!_config.inference_cores.empty()) {
+        // the pool may already run unpinned, started by a warm-up forward
+        // pass on another thread; one thread stops its workers
+        cv::setNumThreads(1);
+    }
+    cv::setNumThreads(cv_threads);
+}
+
+void CoreBudget::enter_capture_thread() const {
+    pin(_config.capture_cores);
+    if (!_config.is_capture_priority_raised) {
+        return;
+    }
+
+    // the lowest real time priority is enough to preempt every normal thread,
+    // and capture blocks on the camera most of the time
+    auto param = sched_param{};
+    param.sched_priority = sched_get_priority_min(SCHED_FIFO);
+    const auto error =
+        pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+    if (error != 0 && !_is_priority_reported.exchange(true)) {
+        LOG_WARNING << "Failed to raise the capture thread priority: "
+                    << std::strerror(error);
+    }
+}
+
+void CoreBudget::enter_gui_thread() const { pin(_config.gui_cores); }
+
+std::string CoreBudget::describe() const {
+    auto result = "cv " + (_config.cv_threads > 0
+                               ? std::to_string(_config.cv_threads)
+                               : std::string{"*"});
+    result += ", capture " + format_cores(_config.capture_cores);
+    result += ", inference " + format_cores(_config.inference_cores);
+    result += ", gui " + format_cores(_config.gui_cores);
+    if (_config.is_capture_priority_raised) {
+        result += ", priority";
+    }
+    return result;
+}
+
+void CoreBudget::pin(const std::vector<int>& cores) const {
+    if (cores.empty()) {
+        return;
+    }
+#ifdef __linux__
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (const auto core : cores) {
+        if (core < CPU_SETSIZE) {
+            CPU_SET(core, &set);
+        }
+    }
+    const auto error =
+        pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+    if (error != 0 && !_is_pin_reported.exchange(true)) {
+        LOG_WARNING << "Failed to pin a thread to cores " << format_cores(cores)
+                    << ": " << std::strerror(error);
+    }
+#else
+    if (!_is_pin_reported.exchange(true)) {
+        LOG_WARNING << "Pinning threads to cores isn't supported here";
+    }
+#endif
+}
+
+std::vector<int> parse_cores(std::string_view list) {
+    std::vector<int> cores;
+    auto rest = list;
+    while (!rest.empty()) {
+        const auto comma = rest.find(',');
+        const auto item = rest.substr(0, comma);
+        rest = comma == std::string_view::npos ? std::string_view{}
+                                               : rest.substr(comma + 1);
+
+        const auto dash = item.find('-');
+        const auto first = parse_core(item.substr(0, dash), list);
+        const auto last = dash == std::string_view::npos
+                              ? first
+                              : parse_core(item.substr(dash + 1), list);
+        if (last < first) {
+            throw std::invalid_argument{"Invalid core list: " +
+                                        std::string{list}};
+        }
+        for (int core = first; core <= last; ++core) {
+            cores.push_back(core);
+        }
+    }
+    if (cores.empty()) {
+        throw std::invalid_argument{"Invalid core list: " + std::string{list}};
+    }
+
+    std::sort(cores.begin(), cores.end());
+    cores.erase(std::unique(cores.begin(), cores.end()), cores.end());
+    return cores;
+}
+
+std::string format_cores(const std::vector<int>& cores) {
+    if (cores.empty()) {
+        return "*";
+    }
+    std::string result;
+    for (std::size_t i = 0; i < cores.size();) {
+        auto j = i;
+        while (j + 1 < cores.size() && cores[j + 1] == cores[j] + 1) {
+            ++j;
+        }
+        if (!result.empty()) {
+            result += ",";
+        }
+        result += std::to_string(cores[i]);
+        if (j > i) {
+            result += "-" + std::to_string(cores[j]);
+        }
+        i = j + 1;
+    }
+    return result;
+}
+
+}  // namespace vision
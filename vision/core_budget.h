@@ -0,0 +1,58 @@
+#pragma once
+
+#include <atomic>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace vision {
+
+struct CoreBudgetConfig {
+    // size of OpenCV's thread pool, 0 keeps OpenCV's default of one thread
+    // per core
+    int cv_threads = 0;
+    // cores each thread may run on, empty leaves the thread to the scheduler
+    std::vector<int> capture_cores;
+    // the pipeline worker, and OpenCV's and the detectors' threads it starts
+    std::vector<int> inference_cores;
+    std::vector<int> gui_cores;
+    // real time scheduling for the capture thread, which needs CAP_SYS_NICE
+    bool is_capture_priority_raised = false;
+};
+
+// Keeps the threads of the application from contending for the same cores.
+// Each thread applies its part of the budget to itself when it starts;
+// threads created afterwards inherit the affinity of the thread creating
+// them, which is how OpenCV's pool ends up on the inference cores. Threads
+// librealsense starts inside the camera aren't covered.
+class CoreBudget {
+   public:
+    explicit CoreBudget(CoreBudgetConfig config = {});
+
+    // sizes OpenCV's pool too and stops workers started elsewhere, they are
+    // recreated on the inference cores by the next parallel loop on this
+    // thread
+    void enter_inference_thread() const;
+    void enter_capture_thread() const;
+    void enter_gui_thread() const;
+
+    const CoreBudgetConfig& config() const { return _config; }
+    // e.g. "cv 4, capture 0, inference 1-3, gui *, priority"
+    std::string describe() const;
+
+   private:
+    void pin(const std::vector<int>& cores) const;
+
+    CoreBudgetConfig _config;
+    // failures are reported once, every pipeline enters them
+    mutable std::atomic<bool> _is_pin_reported = false;
+    mutable std::atomic<bool> _is_priority_reported = false;
+};
+
+// "0,2-5" to {0, 2, 3, 4, 5}, throws std::invalid_argument on anything else,
+// cores beyond what a thread can be pinned to included
+std::vector<int> parse_cores(std::string_view list);
+// the reverse, with runs of cores joined back into ranges
+std::string format_cores(const std::vector<int>& cores);
+
+}  // namespace vision
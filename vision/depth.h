@@ -0,0 +1,74 @@
+#pragma once
+
+#include <memory_resource>
+#include <vector>
+
+#include <opencv2/opencv.hpp>
+
+#include "parsers/parser.h"
+
+namespace vision {
+
+// in meters, NaN without valid depth
+struct DepthStats {
+    float median = std::numeric_limits<float>::quiet_NaN();
+    float min = std::numeric_limits<float>::quiet_NaN();
+    float max = std::numeric_limits<float>::quiet_NaN();
+};
+
+// the depth values are copied into scratch allocated from resource
+inline DepthStats get_depth_stats(
+    const cv::Mat& depth_z16, const cv::Rect& roi, float depth_scale,
+    std::pmr::memory_resource* resource = std::pmr::get_default_resource()) {
+    cv::Rect clipped = roi & cv::Rect(0, 0, depth_z16.cols, depth_z16.rows);
+    if (clipped.empty()) {
+        return {};
+    }
+
+    std::pmr::vector<uint16_t> vals(resource);
+    vals.reserve(clipped.area());
+    for (int y = clipped.y; y < clipped.y + clipped.height; ++y) {
+        const auto* const row = depth_z16.ptr<uint16_t>(y);
+        for (int x = clipped.x; x < clipped.x + clipped.width; ++x) {
+            const auto d = row[x];
+            if (d != 0) {
+                vals.push_back(d);
+            }
+        }
+    }
+
+    if (vals.empty()) {
+        return {};
+    }
+
+    const std::size_t mid = vals.size() / 2;
+    const auto mid_it = vals.begin() + mid;
+    std::nth_element(vals.begin(), mid_it, vals.end());
+    // the partition leaves the extremes one on each side of the median
+    return {.median = *mid_it * depth_scale,
+            .min = *std::min_element(vals.begin(), mid_it + 1) * depth_scale,
+            .max = *std::max_element(mid_it, vals.end()) * depth_scale};
+}
+
+inline float get_median_depth(const cv::Mat& depth_z16, const cv::Rect& roi,
+                              float depth_scale) {
+    return get_depth_stats(depth_z16, roi, depth_scale).median;
+}
+
+// Fills Detection::distance with the median depth inside each box and the
+// depth range with the extremes. The depth frame is expected to be aligned
+// to the frame the detections were made on.
+inline void measure_distances(
+    float depth_scale, std::vector<Detection>& detections,
+    const cv::Mat& depth_z16,
+    std::pmr::memory_resource* resource = std::pmr::get_default_resource()) {
+    for (auto& d : detections) {
+        const auto stats =
+            get_depth_stats(depth_z16, d.box, depth_scale, resource);
+        d.distance = stats.median;
+        d.depth_min = stats.min;
+        d.depth_max = stats.max;
+    }
+}
+
+}  // namespace vision
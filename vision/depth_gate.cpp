@@ -0,0 +1,59 @@
+#include "depth_gate.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace vision {
+
+DepthGate::DepthGate(DepthGateConfig config, float depth_scale)
+    : _config(config),
+      _depth_scale(depth_scale),
+      _min_m(config.min_m),
+      _max_m(config.max_m) {}
+
+void DepthGate::set_range(float min_m, float max_m) {
+    _min_m.store(min_m, std::memory_order_relaxed);
+    _max_m.store(max_m, std::memory_order_relaxed);
+}
+
+void DepthGate::update(const cv::Mat& depth_z16) {
+    // 0 is no depth, so the lower bound is at least one unit
+    const auto lower = std::max(
+        1.0, std::ceil(_min_m.load(std::memory_order_relaxed) / _depth_scale));
+    const auto upper =
+        std::floor(_max_m.load(std::memory_order_relaxed) / _depth_scale);
+
+    // both are vectorized inside OpenCV
+    cv::inRange(depth_z16, cv::Scalar(lower), cv::Scalar(upper), _mask);
+    cv::integral(_mask, _integral, CV_32S);
+}
+
+float DepthGate::fraction(const cv::Rect& roi) const {
+    if (_integral.empty()) {
+        return 1.f;
+    }
+
+    const auto clipped = roi & cv::Rect(0, 0, _mask.cols, _mask.rows);
+    if (clipped.empty()) {
+        return 0.f;
+    }
+
+    const auto x0 = clipped.x;
+    const auto y0 = clipped.y;
+    const auto x1 = clipped.x + clipped.width;
+    const auto y1 = clipped.y + clipped.height;
+    const auto sum = _integral.at<int>(y1, x1) - _integral.at<int>(y0, x1) -
+                     _integral.at<int>(y1, x0) + _integral.at<int>(y0, x0);
+    // mask pixels are 0 or 255
+    return sum / (255.f * clipped.area());
+}
+
+bool DepthGate::is_empty(const cv::Rect& roi) const {
+    return fraction(roi) == 0.f;
+}
+
+bool DepthGate::is_in_range(const cv::Rect& roi) const {
+    return fraction(roi) >= _config.min_fraction;
+}
+
+}  // namespace vision
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <atomic>
+
+#include <opencv2/opencv.hpp>
+
+namespace vision {
+
+struct DepthGateConfig {
+    // working volume in meters
+    float min_m = 0.3f;
+    float max_m = 4.f;
+    // share of a box's pixels which has to be in range to keep the box
+    float min_fraction = 0.2f;
+};
+
+// Masks the depth frame to the working volume and answers which regions
+// fall into it in constant time through an integral image of the mask.
+// Pixels without depth count as out of range. The depth frame has to be
+// aligned to the color frame the regions are in.
+class DepthGate {
+   public:
+    // depth_scale converts Z16 units to meters, see Camera::depth_scale()
+    DepthGate(DepthGateConfig config, float depth_scale);
+
+    // the range may be changed from any thread, it applies from the next
+    // update()
+    void set_range(float min_m, float max_m);
+
+    void update(const cv::Mat& depth_z16);
+
+    // share of the roi's pixels in range
+    float fraction(const cv::Rect& roi) const;
+    // no pixel of the roi is in range, inference on it can be skipped
+    bool is_empty(const cv::Rect& roi) const;
+    // enough of the roi is in range to keep a detection there
+    bool is_in_range(const cv::Rect& roi) const;
+
+   private:
+    DepthGateConfig _config;
+    float _depth_scale;
+    std::atomic<float> _min_m;
+    std::atomic<float> _max_m;
+
+    cv::Mat _mask;
+    cv::Mat _integral;
+};
+
+}  // namespace vision
@@ -0,0 +1,95 @@
+#include "crops.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+cv::Rect grow(const cv::Rect& box, float padding, int min_size) {
+    const auto pad = static_cast<int>(
+        std::round(padding * std::max(box.width, box.height)));
+    const auto w = std::max(box.width + 2 * pad, min_size);
+    const auto h = std::max(box.height + 2 * pad, min_size);
+    const auto cx = box.x + box.width / 2;
+    const auto cy = box.y + box.height / 2;
+    return cv::Rect(cx - w / 2, cy - h / 2, w, h);
+}
+
+}  // namespace
+
+std::vector<cv::Rect> plan_crops(const std::vector<cv::Rect>& boxes,
+                                 cv::Size frame_size, float padding,
+                                 int min_size, float max_area) {
+    const auto frame = cv::Rect(cv::Point(0, 0), frame_size);
+
+    std::vector<cv::Rect> crops;
+    crops.reserve(boxes.size());
+    for (const auto& box : boxes) {
+        const auto crop = grow(box, padding, min_size) & frame;
+        if (!crop.empty()) {
+            crops.push_back(crop);
+        }
+    }
+
+    // merging can make a crop overlap one it was already checked against,
+    // so start over after every merge
+    for (bool is_merged = true; is_merged;) {
+        is_merged = false;
+        for (std::size_t i = 0; i < crops.size() && !is_merged; ++i) {
+            for (std::size_t j = i + 1; j < crops.size(); ++j) {
+                if ((crops[i] & crops[j]).empty()) {
+                    continue;
+                }
+                crops[i] |= crops[j];
+                crops.erase(crops.begin() + j);
+                is_merged = true;
+                break;
+            }
+        }
+    }
+
+    std::size_t area = 0;
+    for (const auto& crop : crops) {
+        area += crop.area();
+    }
+    if (area > max_area * frame.area()) {
+        return {};
+    }
+    return crops;
+}
+
+namespace {
+
+std::vector<int> tile_positions(int length, int tile_size, float overlap) {
+    if (length <= tile_size) {
+        return {0};
+    }
+    const auto min_overlap = static_cast<int>(std::round(overlap * tile_size));
+    const auto stride = std::max(1, tile_size - min_overlap);
+    const auto n = 1 + (length - tile_size + stride - 1) / stride;
+
+    std::vector<int> positions;
+    positions.reserve(n);
+    for (int i = 0; i < n; ++i) {
+        // the last tile ends exactly at the frame edge
+        positions.push_back(i * (length - tile_size) / (n - 1));
+    }
+    return positions;
+}
+
+}  // namespace
+
+std::vector<cv::Rect> plan_tiles(cv::Size frame_size, int tile_size,
+                                 float overlap) {
+    const auto tile_w = std::min(tile_size, frame_size.width);
+    const auto tile_h = std::min(tile_size, frame_size.height);
+
+    std::vector<cv::Rect> tiles;
+    for (const auto y : tile_positions(frame_size.height, tile_size, overlap)) {
+        for (const auto x :
+             tile_positions(frame_size.width, tile_size, overlap)) {
+            tiles.emplace_back(x, y, tile_w, tile_h);
+        }
+    }
+    return tiles;
+}
@@ -0,0 +1,19 @@
+#pragma once
+
+#include <vector>
+
+#include <opencv2/opencv.hpp>
+
+// Regions to run the detector on instead of the whole frame: every box padded
+// by padding times its larger side, grown to at least min_size and clipped to
+// the frame, with overlapping regions merged. Empty when the regions would
+// cover more than max_area of the frame, the full frame is cheaper then.
+std::vector<cv::Rect> plan_crops(const std::vector<cv::Rect>& boxes,
+                                 cv::Size frame_size, float padding,
+                                 int min_size, float max_area);
+
+// Tiles of tile_size covering the frame, neighbours overlapping by at least
+// overlap times tile_size and spread evenly. A frame side shorter than a
+// tile gets a single tile of the frame's length.
+std::vector<cv::Rect> plan_tiles(cv::Size frame_size, int tile_size,
+                                 float overlap);
@@ -2,8 +2,24 @@
 
 Letterbox img_to_letterbox(const cv::Mat& src, int lb_w, int lb_h,
                            const cv::Scalar& fill_color) {
-    const int src_w = src.cols;
-    const int src_h = src.rows;
+    return img_to_letterbox(src, cv::Rect(0, 0, src.cols, src.rows), lb_w,
+                            lb_h, fill_color);
+}
+
+Letterbox img_to_letterbox(const cv::Mat& src, const cv::Rect& roi, int lb_w,
+                           int lb_h, const cv::Scalar& fill_color) {
+    Letterbox letterbox;
+    cv::Mat resized;
+    img_to_letterbox(src, roi, lb_w, lb_h, fill_color, letterbox, resized);
+    return letterbox;
+}
+
+void img_to_letterbox(const cv::Mat& src, const cv::Rect& roi, int lb_w,
+                      int lb_h, const cv::Scalar& fill_color,
+                      Letterbox& letterbox, cv::Mat& resized) {
+    const auto clipped = roi & cv::Rect(0, 0, src.cols, src.rows);
+    const int src_w = clipped.width;
+    const int src_h = clipped.height;
     const float aspect_ratio = std::min(static_cast<float>(lb_w) / src_w,
                                         static_cast<float>(lb_h) / src_h);
 
@@ -12,15 +28,54 @@ Letterbox img_to_letterbox(const cv::Mat& src, int lb_w, int lb_h,
     const int lb_img_x = (lb_w - lb_img_w) / 2;
     const int lb_img_y = (lb_h - lb_img_h) / 2;
 
-    cv::Mat resized;
-    cv::resize(src, resized, cv::Size(lb_img_w, lb_img_w));
-
-    cv::Mat dst;
-    cv::copyMakeBorder(resized, dst, lb_img_y, lb_h - lb_img_h - lb_img_y,
-                       lb_img_x, lb_w - lb_img_w - lb_img_x,
-                       cv::BORDER_CONSTANT, fill_color);
-    return {aspect_ratio, lb_img_y, lb_img_x, lb_img_w,
-            lb_img_h,     src_w,    src_h,    dst};
+    cv::resize(src(clipped), resized, cv::Size(lb_img_w, lb_img_h));
+
+    cv::copyMakeBorder(resized, letterbox.data, lb_img_y,
+                       lb_h - lb_img_h - lb_img_y, lb_img_x,
+                       lb_w - lb_img_w - lb_img_x, cv::BORDER_CONSTANT,
+                       fill_color);
+    // the padding only adds up to the letterbox when the image was resized
+    // with the scaled width and height of the source
+    CV_DbgAssert(letterbox.data.size() == cv::Size(lb_w, lb_h));
+
+    letterbox.aspect_ratio = aspect_ratio;
+    letterbox.img_y = lb_img_y;
+    letterbox.img_x = lb_img_x;
+    letterbox.img_w = lb_img_w;
+    letterbox.img_h = lb_img_h;
+    letterbox.src_w = src_w;
+    letterbox.src_h = src_h;
+    letterbox.src_x = clipped.x;
+    letterbox.src_y = clipped.y;
+}
+
+cv::Mat letterbox_to_blob(const Letterbox& letterbox) {
+    cv::Mat blob;
+    letterbox_to_blob(letterbox, blob);
+    return blob;
+}
+
+void letterbox_to_blob(const Letterbox& letterbox, cv::Mat& blob) {
+    // what cv::dnn::blobFromImage does with swapRB and a 1 / 255 scale, in
+    // one pass and without its temporary images
+    const auto& image = letterbox.data;
+    CV_Assert(image.type() == CV_8UC3);
+    const int sizes[] = {1, 3, image.rows, image.cols};
+    blob.create(4, sizes, CV_32F);
+
+    const auto plane = static_cast<std::size_t>(image.rows) * image.cols;
+    auto* r = blob.ptr<float>();
+    auto* g = r + plane;
+    auto* b = g + plane;
+    constexpr auto scale = 1.f / 255.f;
+    for (int y = 0; y < image.rows; ++y) {
+        const auto* row = image.ptr<std::uint8_t>(y);
+        for (int x = 0; x < image.cols; ++x, row += 3) {
+            *b++ = row[0] * scale;
+            *g++ = row[1] * scale;
+            *r++ = row[2] * scale;
+        }
+    }
 }
 
 std::optional<cv::Rect> box_from_letterbox(float lb_cx, float lb_cy, float lb_w,
@@ -43,8 +98,10 @@ std::optional<cv::Rect> box_from_letterbox(float lb_cx, float lb_cy, float lb_w,
     int iw = std::min(letterbox.src_w - ix, (int)std::round(x1 - x0));
     int ih = std::min(letterbox.src_h - iy, (int)std::round(y1 - y0));
 
-    return (iw <= 0 || ih <= 0) ? std::nullopt
-                                : std::make_optional(cv::Rect{ix, iy, iw, ih});
+    return (iw <= 0 || ih <= 0)
+               ? std::nullopt
+               : std::make_optional(cv::Rect{ix + letterbox.src_x,
+                                             iy + letterbox.src_y, iw, ih});
 }
 
 std::optional<cv::Rect> box_from_letterbox(const cv::Rect& rect,
@@ -8,10 +8,28 @@ struct Letterbox {
     int src_w, src_h;
 
     cv::Mat data;
+
+    // origin of the letterboxed crop in the full frame
+    int src_x = 0, src_y = 0;
 };
 
 Letterbox img_to_letterbox(const cv::Mat& src, int lb_w, int lb_h,
                            const cv::Scalar& fill_color);
+// letterboxes the roi of src, boxes map back to full frame coordinates
+Letterbox img_to_letterbox(const cv::Mat& src, const cv::Rect& roi, int lb_w,
+                           int lb_h, const cv::Scalar& fill_color);
+
+// Same into letterbox, whose data is overwritten in place when it has the
+// size of the previous call, so nothing else may still be reading it;
+// resized is scratch reused the same way
+void img_to_letterbox(const cv::Mat& src, const cv::Rect& roi, int lb_w,
+                      int lb_h, const cv::Scalar& fill_color,
+                      Letterbox& letterbox, cv::Mat& resized);
+
+// NCHW float blob scaled to [0, 1] with channels swapped to RGB
+cv::Mat letterbox_to_blob(const Letterbox& letterbox);
+// same into blob, reused when it has the size of the previous call
+void letterbox_to_blob(const Letterbox& letterbox, cv::Mat& blob);
 
 std::optional<cv::Rect> box_from_letterbox(float lb_cx, float lb_cy, float lb_w,
                                            float lb_h,
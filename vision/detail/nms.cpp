@@ -0,0 +1,59 @@
+#include "nms.h"
+
+#include <algorithm>
+
+std::pmr::vector<int> apply_nms(const vision::DetectionsRaw& detections,
+                                const vision::Thresholds& thresholds,
+                                std::size_t class_num, bool is_class_agnostic,
+                                std::pmr::memory_resource* resource) {
+    const auto class_of = [&](int i) {
+        return is_class_agnostic ? 0 : detections.class_ids[i];
+    };
+
+    // candidates above the score threshold grouped by class, best first and
+    // in their original order among equal scores like NMSBoxes' stable sort
+    std::pmr::vector<int> order(resource);
+    order.reserve(detections.scores.size());
+    for (int i = 0; i < static_cast<int>(detections.scores.size()); ++i) {
+        const auto class_id = class_of(i);
+        if (detections.scores[i] > thresholds.score && class_id >= 0 &&
+            (is_class_agnostic ||
+             static_cast<std::size_t>(class_id) < class_num)) {
+            order.push_back(i);
+        }
+    }
+    std::sort(order.begin(), order.end(), [&](int a, int b) {
+        if (class_of(a) != class_of(b)) {
+            return class_of(a) < class_of(b);
+        }
+        if (detections.scores[a] != detections.scores[b]) {
+            return detections.scores[a] > detections.scores[b];
+        }
+        return a < b;
+    });
+
+    std::pmr::vector<int> kept(resource);
+    kept.reserve(order.size());
+    std::size_t class_begin = 0;
+    for (const auto i : order) {
+        if (!kept.empty() && class_of(kept.back()) != class_of(i)) {
+            class_begin = kept.size();
+        }
+        const auto is_suppressed = std::any_of(
+            kept.begin() + class_begin, kept.end(), [&](int k) {
+                return box_iou(detections.boxes[i], detections.boxes[k]) >
+                       thresholds.nms;
+            });
+        if (!is_suppressed) {
+            kept.push_back(i);
+        }
+    }
+    return kept;
+}
+
+float box_iou(const cv::Rect& a, const cv::Rect& b) {
+    const auto intersection = (a & b).area();
+    const auto area_union = a.area() + b.area() - intersection;
+    return area_union > 0 ? static_cast<float>(intersection) / area_union
+                          : 0.f;
+}
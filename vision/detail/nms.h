@@ -0,0 +1,19 @@
+#pragma once
+
+#include <memory_resource>
+
+#include "../parsers/parser.h"
+
+// Indices of the detections kept by non maximum suppression, each class by
+// descending score. Class aware suppression runs NMS per class, so
+// overlapping boxes of different classes are all kept. Matches
+// cv::dnn::NMSBoxes, but the scratch and the result are allocated from
+// resource instead of the heap.
+std::pmr::vector<int> apply_nms(const vision::DetectionsRaw& detections,
+                                const vision::Thresholds& thresholds,
+                                std::size_t class_num, bool is_class_agnostic,
+                                std::pmr::memory_resource* resource =
+                                    std::pmr::get_default_resource());
+
+// Intersection over union, 0 for boxes which don't overlap
+float box_iou(const cv::Rect& a, const cv::Rect& b);
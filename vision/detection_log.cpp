@@ -0,0 +1,411 @@
+#include "detection_log.h"
+
+#include <fcntl.h>
+#include <librealsense2/rsutil.h>
+#include <lz4.h>
+#include <plog/Log.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <limits>
+#include <stdexcept>
+
+#include "perf/metrics.h"
+
+namespace {
+
+constexpr auto NaN = std::numeric_limits<float>::quiet_NaN();
+
+struct Position {
+    float x = NaN;
+    float y = NaN;
+    float z = NaN;
+};
+
+// box center deprojected at the median depth, unknown without intrinsics
+Position get_position(const vision::Detection& detection,
+                      const rs2_intrinsics& intrinsics) {
+    if (intrinsics.fx <= 0.f || std::isnan(detection.distance)) {
+        return {};
+    }
+    const float pixel[2] = {detection.box.x + detection.box.width / 2.f,
+                            detection.box.y + detection.box.height / 2.f};
+    float point[3];
+    rs2_deproject_pixel_to_point(point, &intrinsics, pixel,
+                                 detection.distance);
+    return {.x = point[0], .y = point[1], .z = point[2]};
+}
+
+template <typename T>
+void write_value(std::ofstream& file, const T& value) {
+    file.write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+// longer labels are cut
+std::uint16_t label_size(const std::string& label) {
+    return static_cast<std::uint16_t>(
+        std::min<std::size_t>(label.size(), UINT16_MAX));
+}
+
+void write_labels(std::ofstream& file, const vision::LabelTable& table) {
+    auto header = vision::LogLabelsHeader{
+        .magic = vision::LOG_LABELS_MAGIC,
+        .model_id = table.model_id,
+        .labels_num = static_cast<std::uint32_t>(table.labels.size()),
+        .size = 0};
+    for (const auto& label : table.labels) {
+        header.size += sizeof(std::uint16_t) + label_size(label);
+    }
+    write_value(file, header);
+    for (const auto& label : table.labels) {
+        const auto size = label_size(label);
+        write_value(file, size);
+        file.write(label.data(), size);
+    }
+}
+
+}  // namespace
+
+namespace vision {
+
+void DetectionColumns::clear() {
+    for_each_column([](auto& column) { column.clear(); });
+}
+
+void DetectionColumns::reserve(std::size_t rows) {
+    for_each_column([rows](auto& column) { column.reserve(rows); });
+}
+
+DetectionLog::DetectionLog(const std::string& path,
+                           DetectionLogConfig config)
+    : _config(config) {
+    auto is_new = true;
+    if (std::filesystem::exists(path) &&
+        std::filesystem::file_size(path) > 0) {
+        const auto size = std::filesystem::file_size(path);
+        const auto reader = DetectionLogReader(path);
+        const auto valid_size = reader.valid_size();
+        if (valid_size < size) {
+            LOG_WARNING << "Cutting " << size - valid_size
+                        << " bytes of an incomplete record off " << path;
+            std::filesystem::resize_file(path, valid_size);
+        }
+        is_new = false;
+    }
+
+    _file.open(path, std::ios::binary | std::ios::app);
+    if (!_file) {
+        throw std::runtime_error{"Failed to open detection log: " + path};
+    }
+    if (is_new) {
+        write_value(_file, LogFileHeader{.magic = LOG_FILE_MAGIC,
+                                         .version = LOG_VERSION});
+        _file.flush();
+    }
+
+    _block.reserve(_config.rows_per_block);
+    _thread = std::thread(&DetectionLog::run, this);
+}
+
+DetectionLog::~DetectionLog() {
+    {
+        const auto lock = std::lock_guard{_mutex};
+        // the rest is written no matter how far behind the writer is
+        if (_block.size() > 0) {
+            _pending.push_back(std::move(_block));
+        }
+        _is_stopping = true;
+    }
+    _cv.notify_one();
+    _thread.join();
+}
+
+void DetectionLog::set_labels(std::int32_t model_id,
+                              const std::vector<std::string>& labels) {
+    // the detections so far go with the previous labels
+    if (_block.size() > 0) {
+        submit();
+    }
+    {
+        const auto lock = std::lock_guard{_mutex};
+        // never dropped, the rest of the log would be misread without it
+        _pending.push_back(LabelTable{.model_id = model_id, .labels = labels});
+    }
+    _cv.notify_one();
+}
+
+void DetectionLog::append(const Snapshot& snapshot) {
+    const auto timer = perf::ScopedTimer{perf::Stage::Log};
+
+    const auto& frames = snapshot.frames;
+    const auto now = std::chrono::steady_clock::now();
+    if (_block.size() == 0) {
+        _block_start = now;
+    }
+    for (const auto& detection : snapshot.detections) {
+        const auto position = get_position(detection, frames.intrinsics());
+        _block.frame.push_back(frames.number());
+        _block.timestamp.push_back(frames.timestamp());
+        _block.class_id.push_back(detection.class_id);
+        _block.track_id.push_back(detection.track_id);
+        _block.model_id.push_back(detection.model_id);
+        _block.score.push_back(detection.score);
+        _block.x.push_back(detection.box.x);
+        _block.y.push_back(detection.box.y);
+        _block.width.push_back(detection.box.width);
+        _block.height.push_back(detection.box.height);
+        _block.distance.push_back(detection.distance);
+        _block.depth_min.push_back(detection.depth_min);
+        _block.depth_max.push_back(detection.depth_max);
+        _block.position_x.push_back(position.x);
+        _block.position_y.push_back(position.y);
+        _block.position_z.push_back(position.z);
+    }
+
+    if (_block.size() >= _config.rows_per_block ||
+        (_block.size() > 0 && now - _block_start >= _config.flush_interval)) {
+        submit();
+    }
+}
+
+void DetectionLog::submit() {
+    {
+        const auto lock = std::lock_guard{_mutex};
+        if (_pending.size() >= _config.max_pending_blocks) {
+            perf::metrics().add(perf::Counter::LogDrops, _block.size());
+            _block.clear();
+            return;
+        }
+        _pending.push_back(std::move(_block));
+        if (!_free.empty()) {
+            _block = std::move(_free.back());
+            _free.pop_back();
+        }
+    }
+    _cv.notify_one();
+    // only until the first blocks come back from the writer
+    _block.reserve(_config.rows_per_block);
+}
+
+void DetectionLog::run() {
+    auto lock = std::unique_lock{_mutex};
+    while (true) {
+        _cv.wait(lock, [this] { return _is_stopping || !_pending.empty(); });
+        if (_pending.empty()) {
+            return;
+        }
+        auto record = std::move(_pending.front());
+        _pending.pop_front();
+
+        lock.unlock();
+        std::visit([this](auto& value) { write(value); }, record);
+        lock.lock();
+
+        if (auto* block = std::get_if<DetectionColumns>(&record)) {
+            block->clear();
+            _free.push_back(std::move(*block));
+        }
+    }
+}
+
+void DetectionLog::write(const LabelTable& table) {
+    write_labels(_file, table);
+    _file.flush();
+    if (!_file) {
+        LOG_ERROR << "Failed to write the labels of model " << table.model_id
+                  << " to the log";
+        _file.clear();
+    }
+}
+
+void DetectionLog::write(DetectionColumns& block) {
+    if (block.size() == 0) {
+        return;
+    }
+    _raw.clear();
+    block.for_each_column([this](const auto& column) {
+        const auto* bytes = reinterpret_cast<const char*>(column.data());
+        _raw.insert(_raw.end(), bytes,
+                    bytes + column.size() * sizeof(column[0]));
+    });
+
+    auto header = LogBlockHeader{
+        .magic = LOG_BLOCK_MAGIC,
+        .codec = LogCodec::None,
+        .rows = static_cast<std::uint32_t>(block.size()),
+        .raw_size = static_cast<std::uint32_t>(_raw.size()),
+        .stored_size = static_cast<std::uint32_t>(_raw.size()),
+        .reserved = 0,
+        .first_frame = block.frame.front(),
+        .last_frame = block.frame.back(),
+        .first_timestamp = block.timestamp.front(),
+        .last_timestamp = block.timestamp.back()};
+    const char* payload = _raw.data();
+
+    if (_config.is_compressed) {
+        _compressed.resize(LZ4_compressBound(_raw.size()));
+        const auto size =
+            LZ4_compress_default(_raw.data(), _compressed.data(), _raw.size(),
+                                 _compressed.size());
+        // blocks that don't shrink are stored as they are
+        if (size > 0 && static_cast<std::size_t>(size) < _raw.size()) {
+            header.codec = LogCodec::LZ4;
+            header.stored_size = size;
+            payload = _compressed.data();
+        }
+    }
+
+    write_value(_file, header);
+    _file.write(payload, header.stored_size);
+    _file.flush();
+    if (!_file) {
+        LOG_ERROR << "Failed to write " << header.rows
+                  << " detections to the log";
+        _file.clear();
+    }
+}
+
+DetectionLogReader::DetectionLogReader(const std::string& path) {
+    const auto fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw std::runtime_error{"Failed to open detection log: " + path};
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0 ||
+        static_cast<std::size_t>(info.st_size) < sizeof(LogFileHeader)) {
+        close(fd);
+        throw std::runtime_error{"Not a detection log: " + path};
+    }
+    _size = static_cast<std::size_t>(info.st_size);
+    auto* data = mmap(nullptr, _size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        throw std::runtime_error{"Failed to map detection log: " + path};
+    }
+    _data = static_cast<const char*>(data);
+
+    std::size_t offset = 0;
+    // false when the file ends before the value
+    const auto read = [&](auto& value) {
+        if (offset + sizeof(value) > _size) {
+            return false;
+        }
+        std::memcpy(&value, _data + offset, sizeof(value));
+        offset += sizeof(value);
+        return true;
+    };
+    const auto fail = [&](const std::string& reason) {
+        munmap(const_cast<char*>(_data), _size);
+        throw std::runtime_error{reason + ": " + path};
+    };
+
+    // false when the labels run past end
+    const auto read_labels = [&](std::uint32_t labels_num, std::size_t end,
+                                 std::vector<std::string>& labels) {
+        for (std::uint32_t i = 0; i < labels_num; ++i) {
+            std::uint16_t label_size = 0;
+            if (!read(label_size) || offset + label_size > end) {
+                return false;
+            }
+            labels.emplace_back(_data + offset, label_size);
+            offset += label_size;
+        }
+        return true;
+    };
+
+    LogFileHeader header;
+    read(header);
+    if (header.magic != LOG_FILE_MAGIC) {
+        fail("Not a detection log");
+    }
+    if (header.version != LOG_VERSION) {
+        fail("Unsupported detection log version " +
+             std::to_string(header.version));
+    }
+
+    // records up to the first incomplete one, which a crash left behind
+    _valid_size = offset;
+    std::uint32_t magic = 0;
+    while (offset + sizeof(magic) <= _size) {
+        std::memcpy(&magic, _data + offset, sizeof(magic));
+        if (magic == LOG_BLOCK_MAGIC) {
+            Block block{.tables_num = _tables.size()};
+            if (!read(block.header) ||
+                offset + block.header.stored_size > _size) {
+                break;
+            }
+            block.offset = offset - sizeof(LogBlockHeader);
+            offset += block.header.stored_size;
+            _blocks.push_back(block);
+        } else if (magic == LOG_LABELS_MAGIC) {
+            LogLabelsHeader labels_header;
+            if (!read(labels_header) || offset + labels_header.size > _size) {
+                break;
+            }
+            const auto end = offset + labels_header.size;
+            auto table = LabelTable{.model_id = labels_header.model_id};
+            if (!read_labels(labels_header.labels_num, end, table.labels) ||
+                offset != end) {
+                break;
+            }
+            _tables.push_back(std::move(table));
+        } else {
+            break;
+        }
+        _valid_size = offset;
+    }
+}
+
+DetectionLogReader::~DetectionLogReader() {
+    munmap(const_cast<char*>(_data), _size);
+}
+
+const std::vector<std::string>& DetectionLogReader::labels(
+    const Block& block, std::int32_t model_id) const {
+    static const std::vector<std::string> NONE;
+    model_id = std::max(model_id, 0);
+    for (auto i = block.tables_num; i > 0; --i) {
+        if (_tables[i - 1].model_id == model_id) {
+            return _tables[i - 1].labels;
+        }
+    }
+    return NONE;
+}
+
+void DetectionLogReader::read(const Block& block,
+                              DetectionColumns& out) const {
+    const auto& header = block.header;
+    const char* raw = _data + block.offset + sizeof(LogBlockHeader);
+    if (header.codec == LogCodec::LZ4) {
+        _raw.resize(header.raw_size);
+        const auto size = LZ4_decompress_safe(
+            raw, _raw.data(), header.stored_size, header.raw_size);
+        if (size != static_cast<int>(header.raw_size)) {
+            throw std::runtime_error{"Corrupt detection log block at " +
+                                     std::to_string(block.offset)};
+        }
+        raw = _raw.data();
+    } else if (header.stored_size != header.raw_size) {
+        throw std::runtime_error{"Corrupt detection log block at " +
+                                 std::to_string(block.offset)};
+    }
+
+    std::size_t offset = 0;
+    out.for_each_column([&](auto& column) {
+        const auto bytes = header.rows * sizeof(column[0]);
+        if (offset + bytes > header.raw_size) {
+            throw std::runtime_error{"Corrupt detection log block at " +
+                                     std::to_string(block.offset)};
+        }
+        column.resize(header.rows);
+        std::memcpy(column.data(), raw + offset, bytes);
+        offset += bytes;
+    });
+}
+
+}  // namespace vision
@@ -0,0 +1,219 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <variant>
+#include <vector>
+
+#include "pipeline.h"
+
+namespace vision {
+
+// On disk the log is a file header followed by records: blocks, each a
+// block header and the columns of up to DetectionLogConfig::rows_per_block
+// detections, one array per field, optionally LZ4 compressed as a whole; and
+// label tables, written when the log is opened and whenever a model is
+// swapped. The labels of a detection are those of the latest table of its
+// model written before its block. Numbers are stored in the host's byte
+// order.
+//
+//   LogFileHeader | LogLabelsHeader | labels | LogBlockHeader | columns | ...
+//   labels: per label uint16 size and its characters
+
+inline constexpr std::uint32_t LOG_FILE_MAGIC = 0x4c445352;    // "RSDL"
+inline constexpr std::uint32_t LOG_BLOCK_MAGIC = 0x4b4c4252;   // "RBLK"
+inline constexpr std::uint32_t LOG_LABELS_MAGIC = 0x4c424c52;  // "RLBL"
+inline constexpr std::uint32_t LOG_VERSION = 1;
+
+struct LogFileHeader {
+    std::uint32_t magic;
+    std::uint32_t version;
+};
+
+struct LogLabelsHeader {
+    std::uint32_t magic;
+    std::int32_t model_id;
+    std::uint32_t labels_num;
+    // of the labels that follow
+    std::uint32_t size;
+};
+
+struct LabelTable {
+    std::int32_t model_id;
+    std::vector<std::string> labels;
+};
+
+enum class LogCodec : std::uint32_t { None, LZ4 };
+
+struct LogBlockHeader {
+    std::uint32_t magic;
+    LogCodec codec;
+    std::uint32_t rows;
+    // size of the columns before and after compression
+    std::uint32_t raw_size;
+    std::uint32_t stored_size;
+    std::uint32_t reserved;
+    // ranges covered by the block, to skip it without decompressing
+    std::uint64_t first_frame;
+    std::uint64_t last_frame;
+    double first_timestamp;
+    double last_timestamp;
+};
+
+// One row per detection. Frames without detections leave no rows.
+struct DetectionColumns {
+    std::vector<std::uint64_t> frame;
+    // milliseconds, as reported by librealsense
+    std::vector<double> timestamp;
+    std::vector<std::int32_t> class_id;
+    std::vector<std::int32_t> track_id;
+    // -1 unless several models ran together, then the index of the model
+    // in the multi-model detector; -1 uses model 0's labels
+    std::vector<std::int32_t> model_id;
+    std::vector<float> score;
+    std::vector<std::int32_t> x;
+    std::vector<std::int32_t> y;
+    std::vector<std::int32_t> width;
+    std::vector<std::int32_t> height;
+    // meters, NaN if unknown
+    std::vector<float> distance;
+    std::vector<float> depth_min;
+    std::vector<float> depth_max;
+    // box center at the median depth, meters in the color camera's frame
+    std::vector<float> position_x;
+    std::vector<float> position_y;
+    std::vector<float> position_z;
+
+    std::size_t size() const { return frame.size(); }
+    void clear();
+    void reserve(std::size_t rows);
+
+    // visits the columns in their on-disk order
+    template <typename Fn>
+    void for_each_column(Fn&& fn) {
+        fn(frame);
+        fn(timestamp);
+        fn(class_id);
+        fn(track_id);
+        fn(model_id);
+        fn(score);
+        fn(x);
+        fn(y);
+        fn(width);
+        fn(height);
+        fn(distance);
+        fn(depth_min);
+        fn(depth_max);
+        fn(position_x);
+        fn(position_y);
+        fn(position_z);
+    }
+};
+
+struct DetectionLogConfig {
+    std::size_t rows_per_block = 4096;
+    bool is_compressed = true;
+    // partial blocks are written after this long, so a quiet scene still
+    // reaches the disk
+    std::chrono::seconds flush_interval{5};
+    // filled blocks waiting for the writer thread; more are dropped rather
+    // than stalling the pipeline
+    std::size_t max_pending_blocks = 8;
+};
+
+// Appends the detections of every snapshot to a binary log. The pipeline
+// thread only copies them into columns; compression and writing happen on
+// a background thread. Appending to an existing log first cuts off a record
+// left incomplete by a crash.
+class DetectionLog {
+   public:
+    explicit DetectionLog(const std::string& path,
+                          DetectionLogConfig config = {});
+    ~DetectionLog();
+
+    DetectionLog(const DetectionLog&) = delete;
+    DetectionLog& operator=(const DetectionLog&) = delete;
+
+    // Stores the labels of a model so the log can be read without them. Has
+    // to be called for every model before its first detections are
+    // appended and again whenever it is swapped, on the thread appending.
+    void set_labels(std::int32_t model_id,
+                    const std::vector<std::string>& labels);
+    void append(const Snapshot& snapshot);
+
+   private:
+    // a block of detections or a label table
+    using Record = std::variant<DetectionColumns, LabelTable>;
+
+    void submit();
+    void run();
+    void write(DetectionColumns& block);
+    void write(const LabelTable& table);
+
+    DetectionLogConfig _config;
+    std::ofstream _file;
+
+    // pipeline thread only
+    DetectionColumns _block;
+    std::chrono::steady_clock::time_point _block_start;
+
+    std::mutex _mutex;
+    std::condition_variable _cv;
+    std::deque<Record> _pending;
+    // written blocks handed back so their columns are reused
+    std::vector<DetectionColumns> _free;
+    bool _is_stopping = false;
+
+    // writer thread only
+    std::vector<char> _raw;
+    std::vector<char> _compressed;
+    std::thread _thread;
+};
+
+// Reads a log through a read only memory map. Block headers are indexed up
+// front, columns are only decoded when asked for.
+class DetectionLogReader {
+   public:
+    struct Block {
+        LogBlockHeader header;
+        std::size_t offset;
+        // label tables written before the block
+        std::size_t tables_num;
+    };
+
+    explicit DetectionLogReader(const std::string& path);
+    ~DetectionLogReader();
+
+    DetectionLogReader(const DetectionLogReader&) = delete;
+    DetectionLogReader& operator=(const DetectionLogReader&) = delete;
+
+    // in the order they were written
+    const std::vector<LabelTable>& label_tables() const { return _tables; }
+    // The labels a model had when a block was written, empty if none were
+    // stored. Model -1, the detector running alone, is model 0.
+    const std::vector<std::string>& labels(const Block& block,
+                                           std::int32_t model_id) const;
+    const std::vector<Block>& blocks() const { return _blocks; }
+    // bytes up to the end of the last complete block
+    std::size_t valid_size() const { return _valid_size; }
+
+    // decompresses if needed, reusing the storage of out
+    void read(const Block& block, DetectionColumns& out) const;
+
+   private:
+    std::size_t _size = 0;
+    const char* _data = nullptr;
+    std::vector<LabelTable> _tables;
+    std::vector<Block> _blocks;
+    std::size_t _valid_size = 0;
+    mutable std::vector<char> _raw;
+};
+
+}  // namespace vision
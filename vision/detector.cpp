@@ -5,14 +5,33 @@
 
 #include <plog/Log.h>
 
+#include "detail/nms.h"
+#include "perf/metrics.h"
+
 namespace vision {
 
 void Detector::input(const cv::Mat& bgr) {
-    auto blob = this->preprocess(bgr);
-    _runtime.net.setInput(std::move(blob));
+    input(bgr, cv::Rect(0, 0, bgr.cols, bgr.rows), input_size());
+}
+
+void Detector::input(const cv::Mat& bgr, const cv::Rect& roi,
+                     cv::Size input_size) {
+    const auto timer = perf::ScopedTimer{perf::Stage::Preprocess};
+    preprocess(bgr, roi, input_size);
+    perf::metrics().add(perf::Counter::InputPixels, input_size.area());
+    _runtime.engine->set_input(_blob);
+}
+
+void Detector::input(const Letterbox& letterbox, const cv::Mat& blob) {
+    _letterbox = letterbox;
+    _is_letterbox_shared = true;
+    perf::metrics().add(perf::Counter::InputPixels,
+                        letterbox.data.size().area());
+    _runtime.engine->set_input(blob);
 }
 
 void Detector::forward() {
+    const auto timer = perf::ScopedTimer{perf::Stage::Forward};
     // const auto names = _net.getUnconnectedOutLayersNames();
     // std::vector<cv::Mat> outs;
     // _net.forward(outs, names);
@@ -28,7 +47,7 @@ void Detector::forward() {
     // //               << ")\n";
     // // }
     // _outputs = outs.at(0);
-    _outputs = _runtime.net.forward();
+    _outputs = _runtime.engine->forward();
 }
 
 [[nodiscard]] std::vector<Detection> Detector::parse(
@@ -39,54 +58,60 @@ void Detector::forward() {
     }
 
     const auto& data = _outputs.value();
-    _runtime.parser->validate(data);
+    _runtime.parser->validate(data, _letterbox.data.size());
 
-    const auto detections = _runtime.parser->parse(data, thresholds);
-    return apply_nms_filter(detections, thresholds);
+    auto result = [&] {
+        auto detections = [&] {
+            const auto timer = perf::ScopedTimer{perf::Stage::Parse};
+            return _runtime.parser->parse(data, thresholds, _arena->resource());
+        }();
+
+        if (_depth_gate != nullptr) {
+            const auto timer = perf::ScopedTimer{perf::Stage::DepthGate};
+            prune_out_of_range(detections);
+        }
+
+        const auto timer = perf::ScopedTimer{perf::Stage::Nms};
+        return apply_nms_filter(detections, thresholds);
+    }();
+    // the candidates are gone with the scope above
+    _arena->reset();
+    return result;
 }
 
-cv::Mat Detector::preprocess(const cv::Mat& bgr) {
-    _letterbox = img_to_letterbox(bgr, _runtime.input_w, _runtime.input_h,
-                                  _runtime.letterbox_color);
+void Detector::swap_runtime(ModelRuntime& runtime) {
+    std::swap(_runtime, runtime);
+    // outputs of the previous model don't fit the new parser
+    _outputs.reset();
+}
 
-    return cv::dnn::blobFromImage(_letterbox.data, 1.0 / 255.0,
-                                  cv::Size(_runtime.input_w, _runtime.input_h),
-                                  cv::Scalar(), /*swapRB*/ true,
-                                  /*crop*/ false);
+void Detector::preprocess(const cv::Mat& bgr, const cv::Rect& roi,
+                          cv::Size input_size) {
+    if (_is_letterbox_shared) {
+        _letterbox.data.release();
+        _is_letterbox_shared = false;
+    }
+    img_to_letterbox(bgr, roi, input_size.width, input_size.height,
+                     _runtime.letterbox_color, _letterbox, _resized);
+    letterbox_to_blob(_letterbox, _blob);
 }
 
 std::vector<Detection> Detector::apply_nms_filter(
     const DetectionsRaw& detections, const Thresholds& thresholds) const {
-    std::vector<int> filtered;
-    if (is_nms_class_agnostic) {
-        cv::dnn::NMSBoxes(detections.boxes, detections.scores, thresholds.score,
-                          thresholds.nms, filtered);
-    } else {
-        std::vector<int> tmp;
-        for (int c = 0; c < _runtime.labels.size(); ++c) {
-            tmp.clear();
-            std::vector<cv::Rect> boxes_by_class;
-            boxes_by_class.reserve(detections.boxes.size());
-            std::vector<float> scores_by_class;
-            scores_by_class.reserve(detections.scores.size());
-            std::vector<int> map_index;
-            map_index.reserve(detections.boxes.size());
-
-            for (auto i = 0; i < detections.class_ids.size(); ++i)
-                if (detections.class_ids[i] == c) {
-                    boxes_by_class.push_back(detections.boxes[i]);
-                    scores_by_class.push_back(detections.scores[i]);
-                    map_index.push_back(i);
-                }
-            cv::dnn::NMSBoxes(boxes_by_class, scores_by_class, thresholds.score,
-                              thresholds.nms, tmp);
-            for (int k : tmp) {
-                filtered.push_back(map_index[k]);
+    std::pmr::vector<int> filtered(_arena->resource());
+    if (!perf::metrics().is_enabled(perf::Stage::Nms)) {
+        for (int i = 0; i < detections.scores.size(); ++i) {
+            if (detections.scores[i] >= thresholds.score) {
+                filtered.push_back(i);
             }
         }
+    } else {
+        filtered = apply_nms(detections, thresholds, _runtime.labels.size(),
+                             is_nms_class_agnostic, _arena->resource());
     }
 
     std::vector<Detection> result;
+    result.reserve(filtered.size());
     for (auto i : filtered) {
         auto label = label_by_id(detections.class_ids[i]);
         auto score = detections.scores[i];
@@ -96,13 +121,34 @@ std::vector<Detection> Detector::apply_nms_filter(
             continue;
         }
 
-        result.push_back(Detection{
-            .label = std::move(label), .score = score, .box = box.value()});
+        result.push_back(Detection{.label = std::move(label),
+                                   .score = score,
+                                   .box = box.value(),
+                                   .class_id = detections.class_ids[i]});
     }
 
     return result;
 }
 
+void Detector::prune_out_of_range(DetectionsRaw& detections) const {
+    const auto n = detections.boxes.size();
+    std::size_t kept = 0;
+    for (std::size_t i = 0; i < n; ++i) {
+        const auto box = box_from_letterbox(detections.boxes[i], _letterbox);
+        if (!box.has_value() || !_depth_gate->is_in_range(*box)) {
+            continue;
+        }
+        detections.class_ids[kept] = detections.class_ids[i];
+        detections.scores[kept] = detections.scores[i];
+        detections.boxes[kept] = detections.boxes[i];
+        ++kept;
+    }
+    detections.class_ids.resize(kept);
+    detections.scores.resize(kept);
+    detections.boxes.resize(kept);
+    perf::metrics().add(perf::Counter::DepthPruned, n - kept);
+}
+
 std::string Detector::label_by_id(std::size_t id) const {
     if (id >= _runtime.labels.size()) {
         std::cerr << "Wrong id " << id << " for class\n";
@@ -1,18 +1,26 @@
 #pragma once
 
+#include <memory>
+
+#include "depth_gate.h"
 #include "detail/letterbox.h"
+#include "engines/engine.h"
+#include "frame_arena.h"
 #include "parsers/parser.h"
 
 namespace vision {
 
 struct ModelRuntime {
-    cv::dnn::Net net;
+    std::unique_ptr<InferenceEngine> engine;
     std::vector<std::string> labels;
     std::unique_ptr<Parser> parser;
 
     int input_w;
     int input_h;
     cv::Scalar letterbox_color;
+    // exported with dynamic axes, so inputs of other sizes than input_w and
+    // input_h are accepted; can't be told from the graph and has to be set
+    bool is_input_dynamic = false;
 };
 
 class Detector {
@@ -20,21 +28,57 @@ class Detector {
     Detector(ModelRuntime&& runtime) : _runtime(std::move(runtime)) {};
 
     void input(const cv::Mat& bgr);
+    // Letterboxes only the roi to input_size, detections are still in frame
+    // coordinates. Sizes other than the exported one need a model with
+    // dynamic input.
+    void input(const cv::Mat& bgr, const cv::Rect& roi, cv::Size input_size);
+    // a blob preprocessed elsewhere, shared with other models of the same
+    // input geometry
+    void input(const Letterbox& letterbox, const cv::Mat& blob);
     void forward();
     [[nodiscard]] std::vector<Detection> parse(const Thresholds&) const;
 
+    // the size the model was exported with
+    cv::Size input_size() const {
+        return cv::Size(_runtime.input_w, _runtime.input_h);
+    }
+    cv::Scalar letterbox_color() const { return _runtime.letterbox_color; }
+    bool is_input_dynamic() const { return _runtime.is_input_dynamic; }
+
+    const std::vector<std::string>& labels() const { return _runtime.labels; }
+
+    // exchanges the model between frames, runtime gets the previous one
+    void swap_runtime(ModelRuntime& runtime);
+
+    // drops candidates outside the gate's depth range before NMS, the gate
+    // has to be updated with the depth of the frame being parsed
+    void set_depth_gate(const DepthGate* depth_gate) {
+        _depth_gate = depth_gate;
+    }
+
     bool is_nms_class_agnostic = true;
 
    private:
-    [[nodiscard]] cv::Mat preprocess(const cv::Mat& bgr);
+    void preprocess(const cv::Mat& bgr, const cv::Rect& roi,
+                    cv::Size input_size);
     std::vector<Detection> apply_nms_filter(const DetectionsRaw&,
                                             const Thresholds&) const;
+    void prune_out_of_range(DetectionsRaw& detections) const;
     std::string label_by_id(std::size_t id) const;
 
     ModelRuntime _runtime;
 
+    // reused from frame to frame while the input size stays the same
     Letterbox _letterbox;
+    // the data of _letterbox came with a shared blob and isn't ours to reuse
+    bool _is_letterbox_shared = false;
+    cv::Mat _resized;
+    cv::Mat _blob;
     std::optional<cv::Mat> _outputs;
+    const DepthGate* _depth_gate = nullptr;
+    // candidates and NMS scratch of one parse(), which detectors running in
+    // parallel can't share; on the heap to keep detectors movable
+    std::unique_ptr<FrameArena> _arena = std::make_unique<FrameArena>();
 };
 
 }  // namespace vision
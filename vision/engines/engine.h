@@ -0,0 +1,19 @@
+#pragma once
+
+#include <opencv2/opencv.hpp>
+
+namespace vision {
+
+// Runs the model on a preprocessed blob. The parsers only see the output
+// tensor, so anything producing the tensor layout of the model can stand in
+// for it.
+class InferenceEngine {
+   public:
+    virtual ~InferenceEngine() = default;
+
+    virtual void set_input(cv::Mat blob) = 0;
+    // the returned tensor stays valid until the next forward()
+    virtual cv::Mat forward() = 0;
+};
+
+}  // namespace vision
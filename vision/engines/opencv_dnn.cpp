@@ -0,0 +1,41 @@
+#include "opencv_dnn.h"
+
+#include <plog/Log.h>
+
+namespace vision {
+
+OpenCVDnnEngine::OpenCVDnnEngine(const std::string& model_path,
+                                 Precision precision)
+    : _net(cv::dnn::readNetFromONNX(model_path)), _precision(precision) {
+    // the int8 layers are only implemented by the OpenCV backend on CPU
+    _net.setPreferableBackend(cv::dnn::DNN_BACKEND_OPENCV);
+    _net.setPreferableTarget(cv::dnn::DNN_TARGET_CPU);
+
+    if (_precision == Precision::INT8) {
+        try {
+            _net.getOutputDetails(_output_scales, _output_zeropoints);
+        } catch (const cv::Exception&) {
+            // QDQ models usually end in DequantizeLinear and output floats
+            LOG_INFO << "Quantized model outputs floats: " << model_path;
+        }
+    }
+}
+
+void OpenCVDnnEngine::set_input(cv::Mat blob) {
+    _net.setInput(std::move(blob));
+}
+
+cv::Mat OpenCVDnnEngine::forward() {
+    auto output = _net.forward();
+    if (output.depth() == CV_32F || _output_scales.empty()) {
+        return output;
+    }
+
+    // real = scale * (quantized - zero point)
+    const auto scale = _output_scales.front();
+    const auto zeropoint = _output_zeropoints.front();
+    output.convertTo(_dequantized, CV_32F, scale, -zeropoint * scale);
+    return _dequantized;
+}
+
+}  // namespace vision
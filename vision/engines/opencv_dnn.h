@@ -0,0 +1,31 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "engine.h"
+
+namespace vision {
+
+enum class Precision { FP32, INT8 };
+
+class OpenCVDnnEngine : public InferenceEngine {
+   public:
+    // INT8 expects a statically quantized (QDQ) ONNX model
+    explicit OpenCVDnnEngine(const std::string& model_path,
+                             Precision precision = Precision::FP32);
+
+    void set_input(cv::Mat blob) override;
+    // always float, integer outputs of quantized models are dequantized
+    cv::Mat forward() override;
+
+   private:
+    cv::dnn::Net _net;
+    Precision _precision;
+    // per output tensor, empty when the model outputs floats
+    std::vector<float> _output_scales;
+    std::vector<int> _output_zeropoints;
+    cv::Mat _dequantized;
+};
+
+}  // namespace vision
@@ -0,0 +1,142 @@
+#include "replay.h"
+
+#include <stdexcept>
+#include <thread>
+
+#include <plog/Log.h>
+
+namespace vision {
+
+namespace {
+
+// empty at the end of the file and after a record cut short
+cv::Mat read_tensor(std::ifstream& file, const std::string& tensors_path) {
+    TensorHeader header;
+    if (!file.read(reinterpret_cast<char*>(&header), sizeof(header))) {
+        if (file.gcount() != 0) {
+            LOG_WARNING << "Ignoring the truncated last tensor of "
+                        << tensors_path;
+        }
+        return {};
+    }
+    if (header.magic != TENSOR_MAGIC || header.dims <= 0 ||
+        header.dims > TENSOR_MAX_DIMS) {
+        throw std::runtime_error{"Corrupted tensor in file: " + tensors_path};
+    }
+
+    auto tensor = cv::Mat(header.dims, header.sizes, header.type);
+    if (tensor.total() * tensor.elemSize() != header.size) {
+        throw std::runtime_error{"Tensor of unexpected size in file: " +
+                                 tensors_path};
+    }
+    if (!file.read(reinterpret_cast<char*>(tensor.data), header.size)) {
+        LOG_WARNING << "Ignoring the truncated last tensor of "
+                    << tensors_path;
+        return {};
+    }
+    return tensor;
+}
+
+}  // namespace
+
+ReplayEngine::ReplayEngine(const std::string& tensors_path,
+                           std::chrono::microseconds latency)
+    : _latency(latency) {
+    auto file = std::ifstream(tensors_path, std::ios::binary);
+    if (!file) {
+        throw std::runtime_error{"Failed to open tensors file: " +
+                                 tensors_path};
+    }
+    TensorFileHeader header;
+    if (!file.read(reinterpret_cast<char*>(&header), sizeof(header)) ||
+        header.magic != TENSOR_FILE_MAGIC) {
+        throw std::runtime_error{"Not a tensors file: " + tensors_path};
+    }
+    if (header.version != TENSOR_VERSION) {
+        throw std::runtime_error{"Unsupported tensors file version " +
+                                 std::to_string(header.version) + ": " +
+                                 tensors_path};
+    }
+
+    // kept in memory, reading while replaying would add to the latency
+    for (auto tensor = read_tensor(file, tensors_path); !tensor.empty();
+         tensor = read_tensor(file, tensors_path)) {
+        _tensors.push_back(std::move(tensor));
+    }
+    if (_tensors.empty()) {
+        throw std::runtime_error{"No tensors found in file: " + tensors_path};
+    }
+}
+
+void ReplayEngine::set_input(cv::Mat) {}
+
+cv::Mat ReplayEngine::forward() {
+    // sleeping stands in for the model keeping one core busy, which is
+    // enough to exercise the scheduling around it
+    std::this_thread::sleep_for(_latency);
+
+    const auto& tensor = _tensors[_next];
+    _next = (_next + 1) % _tensors.size();
+    return tensor;
+}
+
+TensorRecorder::TensorRecorder(std::unique_ptr<InferenceEngine> engine,
+                               std::string tensors_path)
+    : _engine(std::move(engine)),
+      _tensors_path(std::move(tensors_path)),
+      _file(_tensors_path, std::ios::binary | std::ios::trunc) {
+    if (!_file) {
+        throw std::runtime_error{"Failed to create tensors file: " +
+                                 _tensors_path};
+    }
+    const auto header = TensorFileHeader{.magic = TENSOR_FILE_MAGIC,
+                                         .version = TENSOR_VERSION};
+    _file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+}
+
+TensorRecorder::~TensorRecorder() {
+    LOG_INFO << "Saved " << _written << " tensors to " << _tensors_path;
+}
+
+void TensorRecorder::set_input(cv::Mat blob) {
+    _engine->set_input(std::move(blob));
+}
+
+cv::Mat TensorRecorder::forward() {
+    auto output = _engine->forward();
+    if (!_is_failed) {
+        write(output);
+    }
+    return output;
+}
+
+void TensorRecorder::write(const cv::Mat& tensor) {
+    if (tensor.dims > TENSOR_MAX_DIMS) {
+        LOG_ERROR << "Can't record a tensor of rank " << tensor.dims
+                  << ", stopped recording to " << _tensors_path;
+        _is_failed = true;
+        return;
+    }
+    // rows of a 2D tensor may be padded
+    const auto packed = tensor.isContinuous() ? tensor : tensor.clone();
+
+    auto header = TensorHeader{.magic = TENSOR_MAGIC,
+                               .type = packed.type(),
+                               .dims = packed.dims,
+                               .sizes = {},
+                               .size = packed.total() * packed.elemSize()};
+    for (int i = 0; i < packed.dims; ++i) {
+        header.sizes[i] = packed.size[i];
+    }
+    _file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    _file.write(reinterpret_cast<const char*>(packed.data), header.size);
+    if (!_file) {
+        LOG_ERROR << "Failed to write to " << _tensors_path
+                  << ", stopped recording";
+        _is_failed = true;
+        return;
+    }
+    ++_written;
+}
+
+}  // namespace vision
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "engine.h"
+
+namespace vision {
+
+// On disk a recording is a file header followed by one record per
+// forward(): a tensor header and the tensor's elements, densely packed in
+// the host's byte order. Records are appended as they come, so a recording
+// cut short keeps every complete record.
+//
+//   TensorFileHeader | TensorHeader | elements | TensorHeader | ...
+
+inline constexpr std::uint32_t TENSOR_FILE_MAGIC = 0x52535452;  // "RTSR"
+inline constexpr std::uint32_t TENSOR_MAGIC = 0x4e455452;       // "RTEN"
+inline constexpr std::uint32_t TENSOR_VERSION = 1;
+inline constexpr int TENSOR_MAX_DIMS = 8;
+
+struct TensorFileHeader {
+    std::uint32_t magic;
+    std::uint32_t version;
+};
+
+struct TensorHeader {
+    std::uint32_t magic;
+    // cv::Mat type, CV_32F for the parsers
+    std::int32_t type;
+    std::int32_t dims;
+    std::int32_t sizes[TENSOR_MAX_DIMS];
+    // of the elements that follow
+    std::uint64_t size;
+};
+
+// Returns output tensors recorded from a real model in a loop, taking a
+// fixed amount of time per forward(). Lets the parser, NMS and scheduling be
+// measured without paying for the model.
+class ReplayEngine : public InferenceEngine {
+   public:
+    // tensors_path is a recording written by TensorRecorder
+    ReplayEngine(const std::string& tensors_path,
+                 std::chrono::microseconds latency);
+
+    void set_input(cv::Mat blob) override;
+    cv::Mat forward() override;
+
+   private:
+    std::vector<cv::Mat> _tensors;
+    std::size_t _next = 0;
+    std::chrono::microseconds _latency;
+};
+
+// Passes everything through to another engine and appends each output
+// tensor to a recording for ReplayEngine as it comes
+class TensorRecorder : public InferenceEngine {
+   public:
+    TensorRecorder(std::unique_ptr<InferenceEngine> engine,
+                   std::string tensors_path);
+    ~TensorRecorder() override;
+
+    void set_input(cv::Mat blob) override;
+    cv::Mat forward() override;
+
+   private:
+    void write(const cv::Mat& tensor);
+
+    std::unique_ptr<InferenceEngine> _engine;
+    std::string _tensors_path;
+    std::ofstream _file;
+    std::size_t _written = 0;
+    // stops recording after the first failed write
+    bool _is_failed = false;
+};
+
+}  // namespace vision
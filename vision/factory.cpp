@@ -1,19 +1,14 @@
 #include "factory.h"
 
 #include <fstream>
+#include <map>
+#include <mutex>
 
 #include "parsers/yolov5.h"
 #include "parsers/yolov8.h"
 
 namespace vision {
 
-cv::dnn::Net load_model(const std::string& path) {
-    auto net = cv::dnn::readNetFromONNX(path);
-    net.setPreferableBackend(cv::dnn::DNN_BACKEND_OPENCV);
-    net.setPreferableTarget(cv::dnn::DNN_TARGET_CPU);
-    return net;
-}
-
 std::vector<std::string> load_labels(const std::string& path) {
     auto ifs = std::ifstream{path};
 
@@ -34,7 +29,30 @@ std::vector<std::string> load_labels(const std::string& path) {
     return result;
 }
 
+// Models share label files, and every replica of a model reads the same one,
+// possibly on several threads at once; each file is read once per process.
+std::vector<std::string> cached_labels(const std::string& path) {
+    static std::mutex mutex;
+    static std::map<std::string, std::vector<std::string>> cache;
+
+    const auto lock = std::lock_guard{mutex};
+    if (const auto it = cache.find(path); it != cache.end()) {
+        return it->second;
+    }
+    return cache.emplace(path, load_labels(path)).first->second;
+}
+
 ModelRuntime make_runtime(ModelType model_type, const std::string& model_path,
+                          const std::string& labels_path, int input_w,
+                          int input_h, cv::Scalar letterbox_color,
+                          Precision precision) {
+    return make_runtime(
+        model_type, std::make_unique<OpenCVDnnEngine>(model_path, precision),
+        labels_path, input_w, input_h, letterbox_color);
+}
+
+ModelRuntime make_runtime(ModelType model_type,
+                          std::unique_ptr<InferenceEngine> engine,
                           const std::string& labels_path, int input_w,
                           int input_h, cv::Scalar letterbox_color) {
     const auto create_parser = [&](auto type,
@@ -51,11 +69,11 @@ ModelRuntime make_runtime(ModelType model_type, const std::string& model_path,
         }
     };
 
-    auto labels = load_labels(labels_path);
+    auto labels = cached_labels(labels_path);
     auto parser = create_parser(model_type, labels.size());
 
-    return ModelRuntime{.net = load_model(model_path),
-                        .labels = load_labels(labels_path),
+    return ModelRuntime{.engine = std::move(engine),
+                        .labels = std::move(labels),
                         .parser = std::move(parser),
                         .input_w = input_w,
                         .input_h = input_h,
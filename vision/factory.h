@@ -1,12 +1,20 @@
 #pragma once
 
 #include "detector.h"
+#include "engines/opencv_dnn.h"
 
 namespace vision {
 
 enum class ModelType { YOLOv5, YOLOv8 };
 
+// runs the ONNX model with OpenCV DNN
 ModelRuntime make_runtime(ModelType model_type, const std::string& model_path,
+                          const std::string& labels_path, int input_w,
+                          int input_h, cv::Scalar letterbox_color,
+                          Precision precision = Precision::FP32);
+
+ModelRuntime make_runtime(ModelType model_type,
+                          std::unique_ptr<InferenceEngine> engine,
                           const std::string& labels_path, int input_w,
                           int input_h, cv::Scalar letterbox_color);
 
@@ -0,0 +1,38 @@
+#include "frame_arena.h"
+
+namespace vision {
+
+FrameArena::FrameArena(std::size_t initial_size) : _buffer(initial_size) {
+    _resource.emplace(_buffer.data(), _buffer.size(), &_overflow);
+}
+
+void FrameArena::reset() {
+    _resource->release();
+    if (_overflow.bytes == 0) {
+        return;
+    }
+
+    // the monotonic resource is built on the buffer, which is about to move
+    _resource.reset();
+    _buffer = std::vector<std::byte>(2 * (_buffer.size() + _overflow.bytes));
+    _overflow.bytes = 0;
+    _resource.emplace(_buffer.data(), _buffer.size(), &_overflow);
+}
+
+void* FrameArena::Overflow::do_allocate(std::size_t size,
+                                        std::size_t alignment) {
+    bytes += size;
+    return std::pmr::new_delete_resource()->allocate(size, alignment);
+}
+
+void FrameArena::Overflow::do_deallocate(void* p, std::size_t size,
+                                         std::size_t alignment) {
+    std::pmr::new_delete_resource()->deallocate(p, size, alignment);
+}
+
+bool FrameArena::Overflow::do_is_equal(
+    const std::pmr::memory_resource& other) const noexcept {
+    return this == &other;
+}
+
+}  // namespace vision
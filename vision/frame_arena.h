@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cstddef>
+#include <memory_resource>
+#include <optional>
+#include <vector>
+
+namespace vision {
+
+// Scratch memory for one frame: a monotonic buffer resource over a buffer
+// which is released as a whole with reset() when the frame is done. A frame
+// needing more than the buffer gets the rest from the heap, and the buffer
+// grows to fit it on the next reset(), so frames of a steady size stop
+// allocating after the first few. Not thread safe, one arena per thread.
+class FrameArena {
+   public:
+    explicit FrameArena(std::size_t initial_size = 256 * 1024);
+
+    FrameArena(const FrameArena&) = delete;
+    FrameArena& operator=(const FrameArena&) = delete;
+
+    std::pmr::memory_resource* resource() { return &*_resource; }
+    // everything allocated from resource() since the last reset is invalid
+    // afterwards
+    void reset();
+
+    std::size_t capacity() const { return _buffer.size(); }
+
+   private:
+    // the heap behind the buffer, counting what the frame took from it
+    class Overflow : public std::pmr::memory_resource {
+       public:
+        std::size_t bytes = 0;
+
+       private:
+        void* do_allocate(std::size_t size, std::size_t alignment) override;
+        void do_deallocate(void* p, std::size_t size,
+                           std::size_t alignment) override;
+        bool do_is_equal(
+            const std::pmr::memory_resource& other) const noexcept override;
+    };
+
+    std::vector<std::byte> _buffer;
+    Overflow _overflow;
+    std::optional<std::pmr::monotonic_buffer_resource> _resource;
+};
+
+}  // namespace vision
@@ -0,0 +1,128 @@
+#include "frame_pool.h"
+
+#include <atomic>
+#include <mutex>
+#include <new>
+#include <utility>
+#include <vector>
+
+namespace vision {
+
+struct FramePool::State {
+    std::size_t slab_size;
+    std::mutex mutex;
+    std::vector<FrameBuffer::Slab*> free;
+    std::size_t slabs_num = 0;
+    bool is_closed = false;
+};
+
+// Placed at the start of its allocation, the data follows at the next
+// aligned offset
+struct FrameBuffer::Slab {
+    std::atomic<int> references = 0;
+    std::shared_ptr<FramePool::State> pool;
+
+    std::byte* data() {
+        return reinterpret_cast<std::byte*>(this) + align_frame(sizeof(Slab));
+    }
+
+    static Slab* create(std::shared_ptr<FramePool::State> pool) {
+        const auto size = align_frame(sizeof(Slab)) + pool->slab_size;
+        auto* memory =
+            ::operator new(size, std::align_val_t{FRAME_ALIGNMENT});
+        auto* slab = new (memory) Slab;
+        slab->pool = std::move(pool);
+        return slab;
+    }
+
+    static void destroy(Slab* slab) {
+        slab->~Slab();
+        ::operator delete(slab, std::align_val_t{FRAME_ALIGNMENT});
+    }
+
+    void release() {
+        if (references.fetch_sub(1, std::memory_order_acq_rel) != 1) {
+            return;
+        }
+        {
+            const auto lock = std::lock_guard{pool->mutex};
+            if (!pool->is_closed) {
+                pool->free.push_back(this);
+                return;
+            }
+        }
+        destroy(this);
+    }
+};
+
+FrameBuffer::FrameBuffer(const FrameBuffer& other) : _slab(other._slab) {
+    if (_slab != nullptr) {
+        _slab->references.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+FrameBuffer::FrameBuffer(FrameBuffer&& other) noexcept
+    : _slab(std::exchange(other._slab, nullptr)) {}
+
+FrameBuffer& FrameBuffer::operator=(FrameBuffer other) noexcept {
+    std::swap(_slab, other._slab);
+    return *this;
+}
+
+FrameBuffer::~FrameBuffer() {
+    if (_slab != nullptr) {
+        _slab->release();
+    }
+}
+
+std::byte* FrameBuffer::data() const {
+    return _slab != nullptr ? _slab->data() : nullptr;
+}
+
+std::size_t FrameBuffer::size() const {
+    return _slab != nullptr ? _slab->pool->slab_size : 0;
+}
+
+FramePool::FramePool(std::size_t slab_size)
+    : _state(std::make_shared<State>()) {
+    _state->slab_size = align_frame(slab_size);
+}
+
+FramePool::~FramePool() {
+    std::vector<FrameBuffer::Slab*> free;
+    {
+        const auto lock = std::lock_guard{_state->mutex};
+        _state->is_closed = true;
+        free = std::move(_state->free);
+    }
+    for (auto* slab : free) {
+        FrameBuffer::Slab::destroy(slab);
+    }
+}
+
+FrameBuffer FramePool::acquire() {
+    FrameBuffer::Slab* slab = nullptr;
+    {
+        const auto lock = std::lock_guard{_state->mutex};
+        if (!_state->free.empty()) {
+            slab = _state->free.back();
+            _state->free.pop_back();
+        } else {
+            ++_state->slabs_num;
+        }
+    }
+    if (slab == nullptr) {
+        slab = FrameBuffer::Slab::create(_state);
+    }
+    slab->references.store(1, std::memory_order_relaxed);
+    return FrameBuffer{slab};
+}
+
+std::size_t FramePool::slab_size() const { return _state->slab_size; }
+
+std::size_t FramePool::slabs_num() const {
+    const auto lock = std::lock_guard{_state->mutex};
+    return _state->slabs_num;
+}
+
+}  // namespace vision
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+
+namespace vision {
+
+inline constexpr std::size_t FRAME_ALIGNMENT = 64;
+
+// rounds a size or offset up to FRAME_ALIGNMENT
+constexpr std::size_t align_frame(std::size_t size) {
+    return (size + FRAME_ALIGNMENT - 1) / FRAME_ALIGNMENT * FRAME_ALIGNMENT;
+}
+
+class FramePool;
+
+// Shared handle to a slab of a FramePool. Copies share the slab, which goes
+// back to the pool when the last one is destroyed, from whichever thread
+// that happens on.
+class FrameBuffer {
+   public:
+    FrameBuffer() = default;
+    FrameBuffer(const FrameBuffer& other);
+    FrameBuffer(FrameBuffer&& other) noexcept;
+    FrameBuffer& operator=(FrameBuffer other) noexcept;
+    ~FrameBuffer();
+
+    // FRAME_ALIGNMENT aligned, nullptr for an empty handle
+    std::byte* data() const;
+    std::size_t size() const;
+    explicit operator bool() const { return _slab != nullptr; }
+
+   private:
+    friend class FramePool;
+    struct Slab;
+
+    explicit FrameBuffer(Slab* slab) : _slab(slab) {}
+
+    Slab* _slab = nullptr;
+};
+
+// Recycled fixed size slabs for frame data, so frames can be copied out of
+// librealsense and its buffers released right away instead of being held
+// while the frame is processed. Slabs are allocated when none is free and
+// kept afterwards; as many exist as frames are in flight at most. The pool
+// may be destroyed while buffers are still held, their slabs are freed when
+// they are released.
+class FramePool {
+   public:
+    explicit FramePool(std::size_t slab_size);
+    ~FramePool();
+
+    FramePool(const FramePool&) = delete;
+    FramePool& operator=(const FramePool&) = delete;
+
+    FrameBuffer acquire();
+
+    std::size_t slab_size() const;
+    // slabs allocated so far, free or not
+    std::size_t slabs_num() const;
+
+   private:
+    friend class FrameBuffer;
+    struct State;
+
+    std::shared_ptr<State> _state;
+};
+
+}  // namespace vision
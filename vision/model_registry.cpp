@@ -0,0 +1,187 @@
+#include "model_registry.h"
+
+#include <plog/Log.h>
+
+#include <chrono>
+#include <future>
+#include <stdexcept>
+#include <utility>
+
+#include "detail/letterbox.h"
+
+namespace {
+
+// One inference on a blank frame, which lets OpenCV DNN allocate its buffers
+// and pick its kernels before the model sees the first real frame. Also
+// fails the load if the model doesn't match its parser.
+void warm_up(vision::ModelRuntime& runtime) {
+    const auto frame = cv::Mat(runtime.input_h, runtime.input_w, CV_8UC3,
+                               runtime.letterbox_color);
+    const auto letterbox = img_to_letterbox(
+        frame, runtime.input_w, runtime.input_h, runtime.letterbox_color);
+    runtime.engine->set_input(letterbox_to_blob(letterbox));
+    runtime.parser->validate(runtime.engine->forward(),
+                             cv::Size(runtime.input_w, runtime.input_h));
+}
+
+}  // namespace
+
+namespace vision {
+
+ModelRegistry::ModelRegistry(std::vector<ModelSpec> specs, int replicas)
+    : _specs(std::move(specs)), _replicas(replicas) {
+    _thread = std::thread(&ModelRegistry::run, this);
+}
+
+ModelRegistry::~ModelRegistry() {
+    {
+        const auto lock = std::lock_guard{_mutex};
+        _is_stopping = true;
+    }
+    _cv.notify_one();
+    _thread.join();
+}
+
+std::vector<ModelRuntime> ModelRegistry::make(const std::string& name) {
+    auto runtimes = load(spec(name), _replicas);
+    const auto lock = std::lock_guard{_mutex};
+    _active = name;
+    return runtimes;
+}
+
+ModelRuntime ModelRegistry::make_one(const std::string& name) const {
+    return std::move(load(spec(name), 1).front());
+}
+
+void ModelRegistry::request(const std::string& name) {
+    // throws on the caller's thread for names that don't exist
+    spec(name);
+    {
+        const auto lock = std::lock_guard{_mutex};
+        _requested = name;
+    }
+    _cv.notify_one();
+}
+
+std::optional<std::vector<ModelRuntime>> ModelRegistry::take_ready() {
+    if (!_is_ready.load(std::memory_order_acquire)) {
+        return std::nullopt;
+    }
+    const auto lock = std::lock_guard{_mutex};
+    _is_ready = false;
+    _active = std::move(_ready_name);
+    return std::exchange(_ready, std::nullopt);
+}
+
+void ModelRegistry::retire(std::vector<ModelRuntime>&& runtimes) {
+    {
+        const auto lock = std::lock_guard{_mutex};
+        _retired.push_back(std::move(runtimes));
+    }
+    _cv.notify_one();
+}
+
+std::string ModelRegistry::active() const {
+    const auto lock = std::lock_guard{_mutex};
+    return _active;
+}
+
+std::string ModelRegistry::loading() const {
+    const auto lock = std::lock_guard{_mutex};
+    return _loading;
+}
+
+std::string ModelRegistry::error() const {
+    const auto lock = std::lock_guard{_mutex};
+    return _error;
+}
+
+const ModelSpec& ModelRegistry::spec(const std::string& name) const {
+    for (const auto& spec : _specs) {
+        if (spec.name == name) {
+            return spec;
+        }
+    }
+    throw std::runtime_error{"Unknown model: " + name};
+}
+
+std::vector<ModelRuntime> ModelRegistry::load(const ModelSpec& spec,
+                                              int replicas) const {
+    const auto load_one = [&spec] {
+        auto runtime = make_runtime(spec.type, spec.model_path,
+                                    spec.labels_path, spec.input_w,
+                                    spec.input_h, spec.letterbox_color,
+                                    spec.precision);
+        runtime.is_input_dynamic = spec.is_input_dynamic;
+        warm_up(runtime);
+        return runtime;
+    };
+
+    // replicas are independent, reading and warming them up one after
+    // another would multiply the startup time by the tiled pool size
+    std::vector<std::future<ModelRuntime>> futures;
+    for (int i = 1; i < replicas; ++i) {
+        futures.push_back(std::async(std::launch::async, load_one));
+    }
+    std::vector<ModelRuntime> runtimes;
+    runtimes.push_back(load_one());
+    for (auto& future : futures) {
+        runtimes.push_back(future.get());
+    }
+    return runtimes;
+}
+
+void ModelRegistry::run() {
+    auto lock = std::unique_lock{_mutex};
+    while (true) {
+        _cv.wait(lock, [this] {
+            return _is_stopping || _requested.has_value() || !_retired.empty();
+        });
+        if (_is_stopping) {
+            return;
+        }
+
+        auto retired = std::move(_retired);
+        _retired.clear();
+        const auto requested = std::exchange(_requested, std::nullopt);
+        _loading = requested.value_or("");
+        lock.unlock();
+
+        retired.clear();
+        if (!requested.has_value()) {
+            lock.lock();
+            continue;
+        }
+
+        const auto tp_before = std::chrono::steady_clock::now();
+        std::optional<std::vector<ModelRuntime>> runtimes;
+        std::string error;
+        try {
+            runtimes = load(spec(*requested), _replicas);
+            LOG_INFO << "Loaded model " << *requested << " in "
+                     << std::chrono::duration<float, std::milli>(
+                            std::chrono::steady_clock::now() - tp_before)
+                            .count()
+                     << " ms";
+        } catch (const std::exception& e) {
+            LOG_ERROR << "Failed to load model " << *requested << ": "
+                      << e.what();
+            error = e.what();
+        }
+
+        lock.lock();
+        _loading.clear();
+        _error = std::move(error);
+        if (runtimes.has_value()) {
+            // one loaded before but not taken yet is released below
+            if (_ready.has_value()) {
+                _retired.push_back(std::move(*_ready));
+            }
+            _ready = std::move(runtimes);
+            _ready_name = *requested;
+            _is_ready.store(true, std::memory_order_release);
+        }
+    }
+}
+
+}  // namespace vision
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "factory.h"
+
+namespace vision {
+
+struct ModelSpec {
+    std::string name;
+    ModelType type = ModelType::YOLOv8;
+    std::string model_path;
+    std::string labels_path;
+    int input_w = 640;
+    int input_h = 640;
+    cv::Scalar letterbox_color = cv::Scalar(114, 114, 114);
+    Precision precision = Precision::FP32;
+    // exported with dynamic axes, crops around detections can then run at
+    // sizes smaller than input_w and input_h
+    bool is_input_dynamic = false;
+};
+
+// Models the application can switch between while running. A requested
+// model is loaded and warmed up with one inference on a background thread,
+// the pipeline picks it up between frames with take_ready() and hands the
+// runtimes it replaced back to retire(), which releases them on the same
+// background thread, so neither loading nor unloading costs a frame.
+class ModelRegistry {
+   public:
+    // replicas is the number of runtimes each model is loaded into, one per
+    // detector using it
+    explicit ModelRegistry(std::vector<ModelSpec> specs, int replicas = 1);
+    ~ModelRegistry();
+
+    ModelRegistry(const ModelRegistry&) = delete;
+    ModelRegistry& operator=(const ModelRegistry&) = delete;
+
+    const std::vector<ModelSpec>& models() const { return _specs; }
+
+    // loads on the calling thread, for the model to start with
+    std::vector<ModelRuntime> make(const std::string& name);
+    // a single runtime loaded on the calling thread and not made active, for
+    // models running next to the active one
+    ModelRuntime make_one(const std::string& name) const;
+    // loads in the background, replacing a request not started yet
+    void request(const std::string& name);
+    // replicas of the model loaded last, nullopt while none is ready; cheap
+    // enough to call every frame
+    std::optional<std::vector<ModelRuntime>> take_ready();
+    void retire(std::vector<ModelRuntime>&& runtimes);
+
+    // the model the pipeline runs, the one being loaded and why the last
+    // load failed; empty if there is none
+    std::string active() const;
+    std::string loading() const;
+    std::string error() const;
+
+   private:
+    const ModelSpec& spec(const std::string& name) const;
+    std::vector<ModelRuntime> load(const ModelSpec& spec, int replicas) const;
+    void run();
+
+    std::vector<ModelSpec> _specs;
+    int _replicas;
+
+    mutable std::mutex _mutex;
+    std::condition_variable _cv;
+    std::optional<std::string> _requested;
+    std::optional<std::vector<ModelRuntime>> _ready;
+    std::string _ready_name;
+    std::vector<std::vector<ModelRuntime>> _retired;
+    std::string _active;
+    std::string _loading;
+    std::string _error;
+    bool _is_stopping = false;
+    // lets take_ready() skip the lock while nothing is ready
+    std::atomic<bool> _is_ready = false;
+    std::thread _thread;
+};
+
+}  // namespace vision
@@ -0,0 +1,57 @@
+#include "motion_gate.h"
+
+#include <algorithm>
+#include <cassert>
+#include <utility>
+
+namespace vision {
+
+MotionGate::MotionGate(MotionGateConfig config)
+    : _config(config), _threshold(config.threshold) {}
+
+bool MotionGate::is_moving(const cv::Mat& gray) {
+    assert(gray.type() == CV_8UC1);
+
+    const auto height =
+        std::max(1, _config.width * gray.rows / std::max(1, gray.cols));
+    // area averaging also smooths out sensor noise
+    cv::resize(gray, _current, cv::Size(_config.width, height), 0, 0,
+               cv::INTER_AREA);
+
+    if (_reference.empty() || _reference.size() != _current.size()) {
+        std::swap(_reference, _current);
+        _skipped = 0;
+        return true;
+    }
+
+    // vectorized inside OpenCV
+    const auto score = static_cast<float>(
+        cv::norm(_current, _reference, cv::NORM_L1) / _current.total());
+    _score.store(score, std::memory_order_relaxed);
+
+    if (score < threshold() && _skipped < _config.max_skipped) {
+        ++_skipped;
+        return false;
+    }
+
+    // the buffers swap roles, nothing gets allocated
+    std::swap(_reference, _current);
+    _skipped = 0;
+    return true;
+}
+
+void MotionGate::reset() { _reference.release(); }
+
+void MotionGate::set_threshold(float threshold) {
+    _threshold.store(threshold, std::memory_order_relaxed);
+}
+
+float MotionGate::threshold() const {
+    return _threshold.load(std::memory_order_relaxed);
+}
+
+float MotionGate::score() const {
+    return _score.load(std::memory_order_relaxed);
+}
+
+}  // namespace vision
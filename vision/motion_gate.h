@@ -0,0 +1,48 @@
+#pragma once
+
+#include <atomic>
+
+#include <opencv2/opencv.hpp>
+
+namespace vision {
+
+struct MotionGateConfig {
+    // width of the downsampled copy, the height keeps the aspect ratio
+    int width = 80;
+    // mean absolute difference in gray levels which counts as motion
+    float threshold = 3.f;
+    // static frames in a row after which the detector runs anyway, so slow
+    // changes like lighting don't leave detections stale forever
+    int max_skipped = 150;
+};
+
+// Tells static scenes apart from moving ones on a tiny downsampled copy of a
+// grayscale or infrared frame. Frames are compared with the last frame which
+// was let through rather than the previous one, so slow motion adds up
+// until it passes the threshold.
+class MotionGate {
+   public:
+    explicit MotionGate(MotionGateConfig config = {});
+
+    // true when the detector should run on the frame
+    bool is_moving(const cv::Mat& gray);
+    // lets the next frame through
+    void reset();
+
+    // the threshold and the score may be accessed from any thread
+    void set_threshold(float threshold);
+    float threshold() const;
+    // difference of the latest frame, in gray levels
+    float score() const;
+
+   private:
+    MotionGateConfig _config;
+    std::atomic<float> _threshold;
+    std::atomic<float> _score = 0.f;
+
+    cv::Mat _reference;
+    cv::Mat _current;
+    int _skipped = 0;
+};
+
+}  // namespace vision
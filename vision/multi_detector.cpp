@@ -0,0 +1,161 @@
+#include "multi_detector.h"
+
+#include <algorithm>
+#include <iterator>
+#include <stdexcept>
+
+#include "perf/metrics.h"
+
+namespace vision {
+
+MultiDetector::MultiDetector(std::vector<Detector*> detectors)
+    : _detectors(std::move(detectors)) {
+    if (_detectors.empty()) {
+        throw std::runtime_error{"Multi-model detector needs a detector"};
+    }
+    _detections.resize(_detectors.size());
+    _workers.reserve(_detectors.size() - 1);
+    for (std::size_t i = 1; i < _detectors.size(); ++i) {
+        _workers.emplace_back(&MultiDetector::work, this, i);
+    }
+}
+
+MultiDetector::~MultiDetector() {
+    {
+        const auto lock = std::lock_guard{_mutex};
+        _is_stopping = true;
+    }
+    _work_cv.notify_all();
+    for (auto& worker : _workers) {
+        worker.join();
+    }
+}
+
+std::vector<Detection> MultiDetector::detect(const cv::Mat& bgr,
+                                             const Thresholds& thresholds,
+                                             const DepthGate* depth_gate) {
+    plan_geometries();
+    {
+        const auto timer = perf::ScopedTimer{perf::Stage::Preprocess};
+        // in place, the previous frame's forward passes are done with them
+        const auto frame = cv::Rect(0, 0, bgr.cols, bgr.rows);
+        for (auto& geometry : _geometries) {
+            img_to_letterbox(bgr, frame, geometry.input_size.width,
+                             geometry.input_size.height,
+                             geometry.letterbox_color, geometry.letterbox,
+                             geometry.resized);
+            letterbox_to_blob(geometry.letterbox, geometry.blob);
+        }
+    }
+
+    {
+        const auto lock = std::lock_guard{_mutex};
+        _thresholds = thresholds;
+        _depth_gate = depth_gate;
+        _pending = _workers.size();
+        _error = nullptr;
+        ++_generation;
+    }
+    _work_cv.notify_all();
+
+    // the calling thread runs the first model instead of waiting idle, and
+    // waits for the workers even if it fails since they use the blobs
+    std::exception_ptr error;
+    std::vector<Detection> detections;
+    try {
+        detections = run(0);
+    } catch (...) {
+        error = std::current_exception();
+    }
+    {
+        auto lock = std::unique_lock{_mutex};
+        _done_cv.wait(lock, [this] { return _pending == 0; });
+        if (error == nullptr) {
+            error = _error;
+        }
+    }
+    if (error != nullptr) {
+        std::rethrow_exception(error);
+    }
+
+    for (std::size_t i = 1; i < _detections.size(); ++i) {
+        std::move(_detections[i].begin(), _detections[i].end(),
+                  std::back_inserter(detections));
+        _detections[i].clear();
+    }
+    return detections;
+}
+
+std::vector<Detection> MultiDetector::run(std::size_t i) {
+    // the engines only read the shared blob
+    auto& detector = *_detectors[i];
+    const auto& geometry = _geometries[_geometry_of[i]];
+    detector.set_depth_gate(_depth_gate);
+    detector.input(geometry.letterbox, geometry.blob);
+    detector.forward();
+    auto detections = detector.parse(_thresholds);
+    for (auto& d : detections) {
+        d.model_id = static_cast<int>(i);
+    }
+    return detections;
+}
+
+void MultiDetector::work(std::size_t i) {
+    std::uint64_t generation = 0;
+    while (true) {
+        {
+            auto lock = std::unique_lock{_mutex};
+            _work_cv.wait(lock, [&] {
+                return _is_stopping || _generation != generation;
+            });
+            if (_is_stopping) {
+                return;
+            }
+            generation = _generation;
+        }
+
+        std::exception_ptr error;
+        try {
+            _detections[i] = run(i);
+        } catch (...) {
+            error = std::current_exception();
+        }
+        {
+            const auto lock = std::lock_guard{_mutex};
+            if (_error == nullptr) {
+                _error = error;
+            }
+            --_pending;
+        }
+        _done_cv.notify_one();
+    }
+}
+
+void MultiDetector::plan_geometries() {
+    // planned every frame, a hot swapped model may need another input size
+    std::size_t used = 0;
+    _geometry_of.resize(_detectors.size());
+    for (std::size_t i = 0; i < _detectors.size(); ++i) {
+        const auto input_size = _detectors[i]->input_size();
+        const auto color = _detectors[i]->letterbox_color();
+        const auto it = std::find_if(
+            _geometries.begin(), _geometries.begin() + used,
+            [&](const Geometry& geometry) {
+                return geometry.input_size == input_size &&
+                       geometry.letterbox_color == color;
+            });
+        if (it != _geometries.begin() + used) {
+            _geometry_of[i] = it - _geometries.begin();
+            continue;
+        }
+        if (used == _geometries.size()) {
+            _geometries.emplace_back();
+        }
+        _geometries[used].input_size = input_size;
+        _geometries[used].letterbox_color = color;
+        _geometry_of[i] = used++;
+    }
+    _geometries.resize(used);
+}
+
+}  // namespace vision
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "depth_gate.h"
+#include "detector.h"
+
+namespace vision {
+
+// Runs several models on the same frames. Models with the same input size
+// and letterbox color share one letterbox and blob, every other geometry
+// gets its own, and the buffers are reused from frame to frame. The forward
+// passes run in parallel, the calling thread runs the first model and a
+// thread kept for the lifetime of the detector each of the others; the
+// detections of all models come back together tagged with
+// Detection::model_id, the index of the model that found them. Classes of
+// different models are unrelated, so NMS stays within each model.
+class MultiDetector {
+   public:
+    // the detectors stay owned by the caller and have to outlive this
+    explicit MultiDetector(std::vector<Detector*> detectors);
+    ~MultiDetector();
+
+    MultiDetector(const MultiDetector&) = delete;
+    MultiDetector& operator=(const MultiDetector&) = delete;
+
+    [[nodiscard]] std::vector<Detection> detect(
+        const cv::Mat& bgr, const Thresholds& thresholds,
+        const DepthGate* depth_gate = nullptr);
+
+    std::size_t models_num() const { return _detectors.size(); }
+    // preprocessing passes the latest frame needed
+    std::size_t geometries_num() const { return _geometries.size(); }
+
+   private:
+    struct Geometry {
+        cv::Size input_size;
+        cv::Scalar letterbox_color;
+        Letterbox letterbox;
+        cv::Mat resized;
+        cv::Mat blob;
+    };
+
+    void plan_geometries();
+    // runs model i on its geometry's blob, tags the detections with i
+    std::vector<Detection> run(std::size_t i);
+    // worker of model i, runs it once per frame until stopped
+    void work(std::size_t i);
+
+    std::vector<Detector*> _detectors;
+    std::vector<Geometry> _geometries;
+    // index into _geometries per detector
+    std::vector<std::size_t> _geometry_of;
+
+    // the frame the workers are on, set before _generation is bumped
+    Thresholds _thresholds{};
+    const DepthGate* _depth_gate = nullptr;
+    // detections per model, the first is returned by the calling thread
+    std::vector<std::vector<Detection>> _detections;
+
+    std::mutex _mutex;
+    std::condition_variable _work_cv;
+    std::condition_variable _done_cv;
+    // frames handed to the workers so far
+    std::uint64_t _generation = 0;
+    // workers still on the latest frame
+    std::size_t _pending = 0;
+    // the first exception a worker threw on the latest frame
+    std::exception_ptr _error;
+    bool _is_stopping = false;
+    std::vector<std::thread> _workers;
+};
+
+}  // namespace vision
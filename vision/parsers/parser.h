@@ -1,6 +1,10 @@
 #pragma once
 
+#include <limits>
+#include <memory_resource>
+#include <stdexcept>
 #include <string>
+#include <vector>
 
 #include <opencv2/opencv.hpp>
 
@@ -10,12 +14,27 @@ struct Detection {
     std::string label;
     float score;
     cv::Rect box;
+    // median depth inside the box in meters, NaN if unknown
+    float distance = std::numeric_limits<float>::quiet_NaN();
+    // nearest and farthest depth inside the box in meters, NaN if unknown
+    float depth_min = std::numeric_limits<float>::quiet_NaN();
+    float depth_max = std::numeric_limits<float>::quiet_NaN();
+    int class_id = -1;
+    // stable across frames while tracking, -1 otherwise
+    int track_id = -1;
+    // model that found it when several run together, -1 otherwise
+    int model_id = -1;
 };
 
+// Candidates before NMS, usually in a frame's arena
 struct DetectionsRaw {
-    std::vector<int> class_ids;
-    std::vector<float> scores;
-    std::vector<cv::Rect> boxes;
+    explicit DetectionsRaw(std::pmr::memory_resource* resource =
+                               std::pmr::get_default_resource())
+        : class_ids(resource), scores(resource), boxes(resource) {}
+
+    std::pmr::vector<int> class_ids;
+    std::pmr::vector<float> scores;
+    std::pmr::vector<cv::Rect> boxes;
 };
 
 struct Thresholds {
@@ -27,13 +46,40 @@ struct Thresholds {
 class Parser {
    public:
     virtual ~Parser() = default;
+    // input_w and input_h are the size the model was exported with
     Parser(std::size_t class_num, int input_w, int input_h)
         : class_num(class_num), input_w(input_w), input_h(input_h) {}
 
-    virtual DetectionsRaw parse(const cv::Mat&, const Thresholds&) const = 0;
-    virtual void validate(const cv::Mat&) const = 0;
+    // the candidates are allocated from resource
+    virtual DetectionsRaw parse(const cv::Mat&, const Thresholds&,
+                                std::pmr::memory_resource* resource =
+                                    std::pmr::get_default_resource()) const = 0;
+    // input_size is the size of the blob the output was computed from,
+    // which differs from the exported size when crops are run through a
+    // model with dynamic input
+    virtual void validate(const cv::Mat&, cv::Size input_size) const = 0;
 
    protected:
+    // Parsers read float tensors of rank 3. Quantized models have to be
+    // dequantized by the engine before their outputs get here.
+    static void validate_tensor(const cv::Mat& output,
+                                const std::string& model_name) {
+        if (output.dims != 3 || output.depth() != CV_32F) {
+            throw std::runtime_error{
+                "Unexpected output tensor for " + model_name + ": " +
+                std::to_string(output.dims) + " dims of depth " +
+                std::to_string(output.depth()) + " (expected 3 dims of depth " +
+                std::to_string(CV_32F) + ")"};
+        }
+    }
+
+    // grid cells of the three detection heads with strides 8, 16 and 32
+    static int locations_num(cv::Size input_size) {
+        return (input_size.width / 8) * (input_size.height / 8) +
+               (input_size.width / 16) * (input_size.height / 16) +
+               (input_size.width / 32) * (input_size.height / 32);
+    }
+
     std::size_t class_num = 0;
     int input_w = 0;
     int input_h = 0;
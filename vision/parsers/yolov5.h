@@ -8,12 +8,13 @@ class YOLOv5Parser : public Parser {
    public:
     using Parser::Parser;
 
-    DetectionsRaw parse(const cv::Mat& output,
-                        const Thresholds& thresholds) const override {
+    DetectionsRaw parse(const cv::Mat& output, const Thresholds& thresholds,
+                        std::pmr::memory_resource* resource =
+                            std::pmr::get_default_resource()) const override {
         const int rows = output.size[1];  // predictions
         const int dims = output.size[2];  // 85
 
-        DetectionsRaw result;
+        DetectionsRaw result(resource);
 
         auto* data = reinterpret_cast<float*>(output.data);
         for (int i = 0; i < rows; ++i, data += dims) {
@@ -36,7 +37,20 @@ class YOLOv5Parser : public Parser {
         return result;
     }
 
-    void validate(const cv::Mat& output) const override {
+    void validate(const cv::Mat& output,
+                  cv::Size input_size) const override {
+        validate_tensor(output, "YOLOv5");
+
+        const auto actual_rows = output.size[1];
+        // 3 anchors per location
+        const auto expected_rows = 3 * locations_num(input_size);
+        if (actual_rows != expected_rows) {
+            throw std::runtime_error{
+                "Unexpected predictions quantity for YOLOv5: " +
+                std::to_string(actual_rows) + " (expected " +
+                std::to_string(expected_rows) + ")"};
+        }
+
         const auto actual_dims = output.size[2];
         const auto expected_dims =
             class_num + 4 + 1;  // 4 is box points, 1 is objectness
@@ -8,10 +8,9 @@ class YOLOv8Parser : public Parser {
    public:
     using Parser::Parser;
 
-    DetectionsRaw parse(const cv::Mat& output,
-                        const Thresholds& thresholds) const override {
-        validate(output);
-
+    DetectionsRaw parse(const cv::Mat& output, const Thresholds& thresholds,
+                        std::pmr::memory_resource* resource =
+                            std::pmr::get_default_resource()) const override {
         const float* p = output.ptr<float>(0, 4);  // first class channel
         float mn = +1e9f, mx = -1e9f;
         for (int i = 0; i < 100; ++i) {
@@ -24,7 +23,7 @@ class YOLOv8Parser : public Parser {
         const int Nc = C - 4;
         const auto* data = reinterpret_cast<const float*>(output.data);
 
-        DetectionsRaw result;
+        DetectionsRaw result(resource);
 
         auto chan = [&](int c) -> const float* {
             return output.ptr<float>(0, c);
@@ -60,13 +59,14 @@ class YOLOv8Parser : public Parser {
         return result;
     }
 
-    void validate(const cv::Mat& output) const override {
+    void validate(const cv::Mat& output,
+                  cv::Size input_size) const override {
+        validate_tensor(output, "YOLOv8");
+
         const auto actual_features = output.size[1];
         const auto actual_locations = output.size[2];
         const auto expected_features = class_num + 4;  // 4 is box points
-        const auto expected_locations = (input_w / 8) * (input_h / 8) +
-                                        (input_w / 16) * (input_h / 16) +
-                                        (input_w / 32) * (input_h / 32);
+        const auto expected_locations = locations_num(input_size);
 
         if (actual_features != expected_features) {
             throw std::runtime_error{
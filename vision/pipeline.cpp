@@ -0,0 +1,444 @@
+#include "pipeline.h"
+
+#include <algorithm>
+#include <iterator>
+#include <span>
+#include <utility>
+
+#include <opencv2/core/utils/allocator_stats.hpp>
+#include <plog/Log.h>
+
+#include "depth.h"
+#include "detail/crops.h"
+#include "detail/nms.h"
+#include "perf/allocations.h"
+#include "perf/metrics.h"
+
+namespace vision {
+
+Pipeline::Pipeline(FrameSource& source, Detector& detector,
+                   Thresholds thresholds, PipelineConfig config)
+    : _source(source),
+      _detector(detector),
+      _thresholds(thresholds),
+      _scheduler(config.keyframes),
+      _motion_gate(config.motion_gate),
+      _depth_gate(config.depth_gate, source.depth_scale()),
+      _roi_config(config.roi) {}
+
+Pipeline::~Pipeline() { stop(); }
+
+void Pipeline::start() {
+    if (_is_running.exchange(true)) {
+        return;
+    }
+    if (_tiled_detector != nullptr && _multi_detector != nullptr) {
+        LOG_WARNING << "The tiled detector runs the detector alone, the other "
+                       "models of the multi-model detector are not run";
+    }
+    _thread = std::thread(&Pipeline::run, this);
+}
+
+void Pipeline::stop() {
+    _is_running = false;
+    {
+        // a waiting thread either sees the flag or gets the notification
+        const auto lock = std::lock_guard{_captured_mutex};
+    }
+    _captured_cv.notify_all();
+    if (_thread.joinable()) {
+        _thread.join();
+    }
+}
+
+std::shared_ptr<const Snapshot> Pipeline::latest() const {
+    std::lock_guard lock{_latest_mutex};
+    _is_latest_taken = true;
+    perf::metrics().set(perf::Gauge::PresentQueue, 0);
+    return _latest;
+}
+
+void Pipeline::set_inference_enabled(bool flag) {
+    _is_inference_enabled = flag;
+}
+
+void Pipeline::set_tracking_enabled(bool flag) { _is_tracking_enabled = flag; }
+
+void Pipeline::set_motion_gate_enabled(bool flag) {
+    _is_motion_gated = flag;
+}
+
+void Pipeline::set_motion_threshold(float threshold) {
+    _motion_gate.set_threshold(threshold);
+}
+
+float Pipeline::motion_score() const { return _motion_gate.score(); }
+
+void Pipeline::set_roi_enabled(bool flag) { _is_roi_enabled = flag; }
+
+void Pipeline::set_tiled_detector(TiledDetector* tiled_detector) {
+    _tiled_detector = tiled_detector;
+}
+
+void Pipeline::set_multi_detector(MultiDetector* multi_detector) {
+    _multi_detector = multi_detector;
+}
+
+void Pipeline::set_model_registry(ModelRegistry* registry) {
+    _registry = registry;
+}
+
+void Pipeline::set_depth_gate_enabled(bool flag) { _is_depth_gated = flag; }
+
+void Pipeline::set_depth_range(float min_m, float max_m) {
+    _depth_gate.set_range(min_m, max_m);
+}
+
+void Pipeline::set_core_budget(const CoreBudget* core_budget) {
+    _core_budget = core_budget;
+}
+
+void Pipeline::set_callback(Callback callback) {
+    _callback = std::move(callback);
+}
+
+void Pipeline::run() {
+    if (_core_budget != nullptr) {
+        _core_budget->enter_inference_thread();
+    }
+    // started from here to inherit the inference cores unless it has its own
+    auto capture_thread = std::thread(&Pipeline::capture, this);
+
+    while (_is_running) {
+        std::optional<Frames> frames;
+        {
+            auto lock = std::unique_lock{_captured_mutex};
+            _captured_cv.wait(lock, [this] {
+                return _captured.has_value() || !_is_running;
+            });
+            if (!_captured.has_value()) {
+                break;
+            }
+            frames = std::move(_captured);
+            _captured.reset();
+        }
+        _captured_cv.notify_all();
+
+        const auto cpu_time = perf::ScopedCpuTime{perf::Thread::Pipeline};
+        if (const auto ms = perf::metrics().mark(perf::Milestone::FirstFrame);
+            ms.has_value()) {
+            LOG_INFO << "First frame after " << *ms << " ms";
+        }
+
+        const auto allocations_before = perf::thread_allocations();
+        const auto cv_allocations_before =
+            cv::getAllocatorStatistics().getNumberOfAllocations();
+        const auto number = frames->number();
+        std::shared_ptr<const Snapshot> snapshot;
+        try {
+            snapshot =
+                std::make_shared<const Snapshot>(process(std::move(*frames)));
+        } catch (const std::exception& e) {
+            // e.g. a model rejecting its input, the next frame may do better
+            LOG_ERROR << "Failed to process frame " << number << ": "
+                      << e.what();
+            perf::metrics().add(perf::Counter::Failed);
+            _arena.reset();
+            continue;
+        }
+        _arena.reset();
+        // OpenCV counts over all threads, the forward passes of parallel
+        // detectors included
+        const auto allocations =
+            perf::thread_allocations() - allocations_before;
+        perf::metrics().set(
+            perf::Gauge::FrameAllocations,
+            static_cast<std::int64_t>(
+                allocations.count +
+                cv::getAllocatorStatistics().getNumberOfAllocations() -
+                cv_allocations_before));
+        perf::metrics().set(perf::Gauge::FrameAllocatedBytes,
+                            static_cast<std::int64_t>(allocations.bytes));
+
+        perf::metrics().add(perf::Counter::Processed);
+        if (_callback) {
+            _callback(*snapshot);
+        }
+        const auto is_next_captured = [this] {
+            const auto lock = std::lock_guard{_captured_mutex};
+            return _captured.has_value();
+        }();
+        perf::metrics().set(perf::Gauge::CaptureQueue, is_next_captured);
+
+        std::lock_guard lock{_latest_mutex};
+        if (_latest != nullptr && !_is_latest_taken) {
+            perf::metrics().add(perf::Counter::PresentDrops);
+        }
+        _latest = std::move(snapshot);
+        _is_latest_taken = false;
+        perf::metrics().set(perf::Gauge::PresentQueue, 1);
+    }
+
+    capture_thread.join();
+    // holds on to camera buffers otherwise
+    _captured.reset();
+}
+
+void Pipeline::capture() {
+    if (_core_budget != nullptr) {
+        _core_budget->enter_capture_thread();
+    }
+
+    while (_is_running) {
+        // the next frame is captured while the current one is processed,
+        // never more than one ahead
+        {
+            auto lock = std::unique_lock{_captured_mutex};
+            _captured_cv.wait(lock, [this] {
+                return !_captured.has_value() || !_is_running;
+            });
+        }
+        if (!_is_running) {
+            break;
+        }
+
+        std::optional<Frames> frames;
+        try {
+            frames = _source.wait_for_frames();
+        } catch (const std::exception& e) {
+            // rs2::error for timeouts and disconnects, but the frame pool
+            // and other sources can throw too; escaping the capture thread
+            // would terminate the process, the next capture may succeed
+            LOG_ERROR << "Failed to capture frames: " << e.what();
+        }
+        if (!frames.has_value()) {
+            continue;
+        }
+        {
+            const auto lock = std::lock_guard{_captured_mutex};
+            _captured = std::move(frames);
+        }
+        _captured_cv.notify_all();
+    }
+}
+
+void Pipeline::swap_models() {
+    if (_registry == nullptr) {
+        return;
+    }
+    auto runtimes = _registry->take_ready();
+    if (!runtimes.has_value()) {
+        return;
+    }
+
+    _detector.swap_runtime(runtimes->front());
+    if (_tiled_detector != nullptr) {
+        _tiled_detector->swap_runtimes(std::span(*runtimes).subspan(1));
+    }
+    _registry->retire(std::move(*runtimes));
+    ++_models_version;
+
+    // tracks and earlier detections carry the previous model's classes
+    _tracker.clear();
+    _scheduler.reset();
+    _motion_gate.reset();
+    _last_detections.clear();
+}
+
+Snapshot Pipeline::process(Frames&& frames) {
+    swap_models();
+
+    std::vector<Detection> detections;
+    bool is_keyframe = true;
+    bool is_reused = false;
+    bool is_detected = false;
+    if (!_is_inference_enabled) {
+        _tracker.clear();
+        _scheduler.reset();
+        _motion_gate.reset();
+    } else if (is_static(frames)) {
+        // nothing moved since the detector last ran
+        detections = _last_detections;
+        is_keyframe = false;
+        is_reused = true;
+    } else if (!_is_tracking_enabled) {
+        // tracking starts over from a keyframe once it's enabled again
+        _tracker.clear();
+        _scheduler.reset();
+        detections = detect(frames);
+        is_detected = true;
+    } else {
+        is_keyframe = _scheduler.next();
+        if (is_keyframe) {
+            const auto tp_before = std::chrono::steady_clock::now();
+            const auto keyframe_detections = detect(frames);
+            is_detected = true;
+            const auto inference_ms = std::chrono::duration<float, std::milli>(
+                std::chrono::steady_clock::now() - tp_before);
+
+            const auto timer = perf::ScopedTimer{perf::Stage::Track};
+            _tracker.update(keyframe_detections);
+            _scheduler.on_keyframe(inference_ms.count(), _tracker.motion());
+        } else {
+            const auto timer = perf::ScopedTimer{perf::Stage::Track};
+            _tracker.predict();
+        }
+        _tracker.get(detections);
+    }
+
+    if (is_detected) {
+        if (const auto ms =
+                perf::metrics().mark(perf::Milestone::FirstDetection);
+            ms.has_value()) {
+            LOG_INFO << "First detection after " << *ms << " ms";
+        }
+    }
+
+    if ((_is_motion_gated || _is_roi_enabled) && !is_reused) {
+        _last_detections = detections;
+    }
+
+    if (!detections.empty() && perf::metrics().is_enabled(perf::Stage::Depth)) {
+        const auto timer = perf::ScopedTimer{perf::Stage::Depth};
+        measure_distances(frames.depth_scale(), detections, frames.depth(),
+                          _arena.resource());
+    }
+
+    return Snapshot{.frames = std::move(frames),
+                    .detections = std::move(detections),
+                    .is_keyframe = is_keyframe,
+                    .models_version = _models_version};
+}
+
+bool Pipeline::is_static(const Frames& frames) {
+    if (!_is_motion_gated) {
+        _motion_gate.reset();
+        return false;
+    }
+
+    const auto is_moving = [&] {
+        const auto timer = perf::ScopedTimer{perf::Stage::MotionGate};
+        return _motion_gate.is_moving(frames.ir());
+    }();
+    perf::metrics().add(is_moving ? perf::Counter::GatePasses
+                                  : perf::Counter::GateSkips);
+    return !is_moving;
+}
+
+std::vector<Detection> Pipeline::detect(const Frames& frames) {
+    const DepthGate* depth_gate = nullptr;
+    if (_is_depth_gated) {
+        const auto timer = perf::ScopedTimer{perf::Stage::DepthGate};
+        _depth_gate.update(frames.depth());
+        depth_gate = &_depth_gate;
+    }
+    _detector.set_depth_gate(depth_gate);
+
+    if (_is_roi_enabled &&
+        ++_since_full_frame < _roi_config.full_frame_interval) {
+        std::vector<cv::Rect> boxes;
+        boxes.reserve(_last_detections.size());
+        for (const auto& d : _last_detections) {
+            boxes.push_back(d.box);
+        }
+        // crops smaller than half the input would only be upscaled
+        const auto input_size = crop_input_size();
+        const auto crops = plan_crops(
+            boxes, frames.color().size(), _roi_config.padding,
+            std::min(input_size.width, input_size.height) / 2,
+            _roi_config.max_area);
+        // every crop is a forward pass of its own, at the model's size a
+        // second crop already costs more than the full frame
+        const auto crops_area =
+            static_cast<long long>(crops.size()) * input_size.area();
+        if (!crops.empty() && crops_area <= _detector.input_size().area()) {
+            return detect_crops(frames, crops, depth_gate);
+        }
+    }
+    _since_full_frame = 0;
+    // crop runs are counted as RoiFrames only
+    perf::metrics().add(perf::Counter::Keyframes);
+
+    if (_tiled_detector != nullptr) {
+        return _tiled_detector->detect(frames.color(), _thresholds,
+                                       depth_gate);
+    }
+    const auto& color = frames.color();
+    if (depth_gate != nullptr &&
+        depth_gate->is_empty(cv::Rect(0, 0, color.cols, color.rows))) {
+        perf::metrics().add(perf::Counter::DepthSkips);
+        return {};
+    }
+    if (_multi_detector != nullptr) {
+        return _multi_detector->detect(color, _thresholds, depth_gate);
+    }
+    _detector.input(color);
+    _detector.forward();
+    return _detector.parse(_thresholds);
+}
+
+cv::Size Pipeline::crop_input_size() {
+    const auto model_size = _detector.input_size();
+    const auto size = cv::Size(_roi_config.input_size, _roi_config.input_size);
+    if (_roi_config.input_size <= 0 || size == model_size) {
+        return model_size;
+    }
+    if (!_detector.is_input_dynamic()) {
+        if (!std::exchange(_is_crop_size_warned, true)) {
+            LOG_WARNING << "Crop size " << _roi_config.input_size
+                        << " needs a model with dynamic input, using "
+                        << model_size.width << "x" << model_size.height;
+        }
+        return model_size;
+    }
+    return size;
+}
+
+std::vector<Detection> Pipeline::detect_crops(
+    const Frames& frames, const std::vector<cv::Rect>& crops,
+    const DepthGate* depth_gate) {
+    perf::metrics().add(perf::Counter::RoiFrames);
+
+    const auto input_size = crop_input_size();
+    std::vector<Detection> detections;
+    std::size_t crops_run = 0;
+    for (const auto& crop : crops) {
+        if (depth_gate != nullptr && depth_gate->is_empty(crop)) {
+            perf::metrics().add(perf::Counter::DepthSkips);
+            continue;
+        }
+        _detector.input(frames.color(), crop, input_size);
+        _detector.forward();
+        auto crop_detections = _detector.parse(_thresholds);
+        std::move(crop_detections.begin(), crop_detections.end(),
+                  std::back_inserter(detections));
+        ++crops_run;
+    }
+    if (crops_run <= 1) {
+        return detections;
+    }
+
+    // merged crops don't overlap, but an object cut by a crop edge can be
+    // found in two of them
+    const auto timer = perf::ScopedTimer{perf::Stage::Nms};
+    DetectionsRaw raw(_arena.resource());
+    int class_num = 0;
+    for (const auto& d : detections) {
+        raw.class_ids.push_back(d.class_id);
+        raw.scores.push_back(d.score);
+        raw.boxes.push_back(d.box);
+        class_num = std::max(class_num, d.class_id + 1);
+    }
+    const auto kept = apply_nms(raw, _thresholds, class_num,
+                                _detector.is_nms_class_agnostic,
+                                _arena.resource());
+
+    std::vector<Detection> result;
+    result.reserve(kept.size());
+    for (const auto i : kept) {
+        result.push_back(std::move(detections[i]));
+    }
+    return result;
+}
+
+}  // namespace vision
@@ -0,0 +1,157 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#include "camera.h"
+#include "core_budget.h"
+#include "depth_gate.h"
+#include "detector.h"
+#include "frame_arena.h"
+#include "model_registry.h"
+#include "motion_gate.h"
+#include "multi_detector.h"
+#include "tiled_detector.h"
+#include "tracker.h"
+
+namespace vision {
+
+struct Snapshot {
+    Frames frames;
+    std::vector<Detection> detections;
+    // false when the detections were propagated by the tracker or reused
+    // for a static scene
+    bool is_keyframe = true;
+    // goes up whenever the registry swaps models in, the detections are the
+    // new models' from then on
+    unsigned models_version = 0;
+};
+
+struct RoiConfig {
+    // square size crops are letterboxed to, 0 for the model's input size;
+    // other sizes are only used with models with dynamic input. Crops only
+    // run while together they have no more input pixels than a full frame,
+    // so at the model's size that is a single crop.
+    int input_size = 0;
+    // padding around each box relative to its larger side
+    float padding = 0.5f;
+    // crops covering more of the frame than this fall back to the full frame
+    float max_area = 0.5f;
+    // detector runs between full frame ones, which find new objects
+    int full_frame_interval = 10;
+};
+
+struct PipelineConfig {
+    KeyframeConfig keyframes;
+    MotionGateConfig motion_gate;
+    RoiConfig roi;
+    DepthGateConfig depth_gate;
+};
+
+// Captures and processes frames on a worker thread. Consumers pick up the
+// newest processed snapshot whenever they are ready for it instead of
+// waiting for the camera or the detector, or receive every snapshot through
+// the callback.
+class Pipeline {
+   public:
+    using Callback = std::function<void(const Snapshot&)>;
+
+    Pipeline(FrameSource& source, Detector& detector, Thresholds thresholds,
+             PipelineConfig config = {});
+    ~Pipeline();
+
+    void start();
+    void stop();
+
+    // nullptr until the first frame is processed
+    std::shared_ptr<const Snapshot> latest() const;
+
+    void set_inference_enabled(bool flag);
+    // runs the detector on keyframes only and tracks the boxes in between
+    void set_tracking_enabled(bool flag);
+    // reuses the last detections while the infrared image doesn't change
+    void set_motion_gate_enabled(bool flag);
+    void set_motion_threshold(float threshold);
+    float motion_score() const;
+    // runs the detector on crops around the previous detections, with full
+    // frames on a slower cadence
+    void set_roi_enabled(bool flag);
+    // used instead of the detector for full frame inference, set before
+    // start()
+    void set_tiled_detector(TiledDetector* tiled_detector);
+    // runs the detector together with other models for full frame
+    // inference, crops around detections still use the detector alone; set
+    // before start(); not used together with a tiled detector
+    void set_multi_detector(MultiDetector* multi_detector);
+    // Models loaded by the registry replace the detector's, and the tiled
+    // detector's after it, between two frames. The registry has to load a
+    // replica for each of them. Set before start().
+    void set_model_registry(ModelRegistry* registry);
+    // Skips crops and tiles without depth in the range and drops candidates
+    // outside of it before NMS. Needs the depth aligned to color.
+    void set_depth_gate_enabled(bool flag);
+    void set_depth_range(float min_m, float max_m);
+    // pins the worker and capture threads and sizes OpenCV's pool, set
+    // before start()
+    void set_core_budget(const CoreBudget* core_budget);
+    // called on the worker thread for every processed snapshot, set before
+    // start()
+    void set_callback(Callback callback);
+
+   private:
+    void run();
+    // on a thread of its own for the life of run()
+    void capture();
+    void swap_models();
+    Snapshot process(Frames&& frames);
+    bool is_static(const Frames& frames);
+    std::vector<Detection> detect(const Frames& frames);
+    cv::Size crop_input_size();
+    std::vector<Detection> detect_crops(const Frames& frames,
+                                        const std::vector<cv::Rect>& crops,
+                                        const DepthGate* depth_gate);
+
+    FrameSource& _source;
+    Detector& _detector;
+    TiledDetector* _tiled_detector = nullptr;
+    MultiDetector* _multi_detector = nullptr;
+    ModelRegistry* _registry = nullptr;
+    const CoreBudget* _core_budget = nullptr;
+    Thresholds _thresholds;
+    Callback _callback;
+
+    std::atomic<bool> _is_running = false;
+    std::atomic<bool> _is_inference_enabled = false;
+    std::atomic<bool> _is_tracking_enabled = false;
+    std::atomic<bool> _is_motion_gated = false;
+    std::atomic<bool> _is_roi_enabled = false;
+    std::atomic<bool> _is_depth_gated = false;
+    // worker thread only, except for the gates' thresholds and ranges
+    Tracker _tracker;
+    KeyframeScheduler _scheduler;
+    MotionGate _motion_gate;
+    DepthGate _depth_gate;
+    // scratch of the frame being processed, reset after each
+    FrameArena _arena;
+    std::vector<Detection> _last_detections;
+    RoiConfig _roi_config;
+    int _since_full_frame = 0;
+    unsigned _models_version = 0;
+    bool _is_crop_size_warned = false;
+    std::thread _thread;
+
+    // the frame captured ahead of the one being processed
+    std::mutex _captured_mutex;
+    std::condition_variable _captured_cv;
+    std::optional<Frames> _captured;
+
+    mutable std::mutex _latest_mutex;
+    std::shared_ptr<const Snapshot> _latest;
+    mutable bool _is_latest_taken = false;
+};
+
+}  // namespace vision
@@ -0,0 +1,86 @@
+#include "shm_publisher.h"
+
+#include <plog/Log.h>
+
+#include <algorithm>
+#include <cstring>
+#include <iterator>
+
+#include "perf/metrics.h"
+
+namespace {
+
+ipc::Intrinsics to_record(const rs2_intrinsics& intrinsics) {
+    ipc::Intrinsics record{.width = intrinsics.width,
+                           .height = intrinsics.height,
+                           .ppx = intrinsics.ppx,
+                           .ppy = intrinsics.ppy,
+                           .fx = intrinsics.fx,
+                           .fy = intrinsics.fy,
+                           .model = static_cast<int>(intrinsics.model)};
+    std::copy(std::begin(intrinsics.coeffs), std::end(intrinsics.coeffs),
+              std::begin(record.coeffs));
+    return record;
+}
+
+void to_record(const vision::Detection& detection,
+               ipc::DetectionRecord& record) {
+    record.class_id = detection.class_id;
+    record.track_id = detection.track_id;
+    record.score = detection.score;
+    record.distance = detection.distance;
+    record.x = detection.box.x;
+    record.y = detection.box.y;
+    record.width = detection.box.width;
+    record.height = detection.box.height;
+    const auto label_size =
+        std::min(detection.label.size(), ipc::LABEL_SIZE - 1);
+    std::memcpy(record.label, detection.label.data(), label_size);
+    record.label[label_size] = '\0';
+}
+
+}  // namespace
+
+namespace vision {
+
+ShmPublisher::ShmPublisher(const std::string& name, int width, int height,
+                           int slots_num)
+    : _ring(name, width, height, slots_num) {}
+
+void ShmPublisher::publish(const Snapshot& snapshot) {
+    const auto timer = perf::ScopedTimer{perf::Stage::Publish};
+
+    const auto& frames = snapshot.frames;
+    const auto size = cv::Size(_ring.width(), _ring.height());
+    if (frames.color().size() != size || frames.depth().size() != size ||
+        frames.ir().size() != size) {
+        if (!_is_size_reported) {
+            LOG_WARNING << "Not publishing frames of " << frames.color().size()
+                        << ", the shared memory ring holds " << size;
+            _is_size_reported = true;
+        }
+        return;
+    }
+
+    auto slot = _ring.begin();
+    // copyTo into matching headers writes in place and drops row padding
+    frames.color().copyTo(cv::Mat(size, CV_8UC3, slot.color));
+    frames.depth().copyTo(cv::Mat(size, CV_16U, slot.depth));
+    frames.ir().copyTo(cv::Mat(size, CV_8U, slot.ir));
+
+    const auto detections_num =
+        std::min(snapshot.detections.size(), ipc::MAX_DETECTIONS);
+    for (std::size_t i = 0; i < detections_num; ++i) {
+        to_record(snapshot.detections[i], slot.detections[i]);
+    }
+    slot.frame = ipc::FrameHeader{
+        .number = frames.number(),
+        .timestamp = frames.timestamp(),
+        .depth_scale = frames.depth_scale(),
+        .is_keyframe = snapshot.is_keyframe,
+        .intrinsics = to_record(frames.intrinsics()),
+        .detections_num = static_cast<std::uint32_t>(detections_num)};
+    _ring.commit();
+}
+
+}  // namespace vision
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <string>
+
+#include "ipc/writer.h"
+#include "pipeline.h"
+
+namespace vision {
+
+// Publishes processed snapshots to other processes on the host through a
+// shared memory ring, since only one process can have the camera open.
+// Frames are copied into the ring once; readers use them in place.
+class ShmPublisher {
+   public:
+    ShmPublisher(const std::string& name, int width, int height,
+                 int slots_num = 4);
+
+    // frames of another size than the ring's are dropped, detections beyond
+    // ipc::MAX_DETECTIONS too
+    void publish(const Snapshot& snapshot);
+
+   private:
+    ipc::RingWriter _ring;
+    bool _is_size_reported = false;
+};
+
+}  // namespace vision
@@ -0,0 +1,98 @@
+#include "sink.h"
+
+#include <cmath>
+#include <cstdio>
+#include <iomanip>
+#include <iostream>
+#include <stdexcept>
+
+namespace {
+
+void write_json_string(std::ostream& out, const std::string& value) {
+    out << '"';
+    for (const auto c : value) {
+        switch (c) {
+            case '"':
+                out << "\\\"";
+                break;
+            case '\\':
+                out << "\\\\";
+                break;
+            case '\b':
+                out << "\\b";
+                break;
+            case '\f':
+                out << "\\f";
+                break;
+            case '\n':
+                out << "\\n";
+                break;
+            case '\r':
+                out << "\\r";
+                break;
+            case '\t':
+                out << "\\t";
+                break;
+            default:
+                if (static_cast<unsigned char>(c) < 0x20) {
+                    // JSON strings can't hold control characters as is
+                    char escaped[7];
+                    std::snprintf(escaped, sizeof(escaped), "\\u%04x",
+                                  static_cast<unsigned>(c));
+                    out << escaped;
+                } else {
+                    out << c;
+                }
+        }
+    }
+    out << '"';
+}
+
+}  // namespace
+
+namespace vision {
+
+ResultsSink::ResultsSink(const std::string& path) : _out(&std::cout) {
+    if (path != "-") {
+        _file.open(path, std::ios::out | std::ios::trunc);
+        if (!_file) {
+            throw std::runtime_error{"Failed to open results file: " + path};
+        }
+        _out = &_file;
+    }
+}
+
+void ResultsSink::write(const Snapshot& snapshot) {
+    auto& out = *_out;
+    out << std::fixed << std::setprecision(3) << "{\"frame\":"
+        << snapshot.frames.number()
+        << ",\"timestamp\":" << snapshot.frames.timestamp()
+        << ",\"keyframe\":" << (snapshot.is_keyframe ? "true" : "false")
+        << ",\"detections\":[";
+
+    for (std::size_t i = 0; i < snapshot.detections.size(); ++i) {
+        const auto& d = snapshot.detections[i];
+        out << (i == 0 ? "" : ",") << "{\"label\":";
+        write_json_string(out, d.label);
+        out << ",\"score\":" << d.score << ",\"box\":[" << d.box.x << ","
+            << d.box.y << "," << d.box.width << "," << d.box.height
+            << "],\"distance\":";
+        if (std::isnan(d.distance)) {
+            out << "null";
+        } else {
+            out << d.distance;
+        }
+        if (d.track_id >= 0) {
+            out << ",\"track\":" << d.track_id;
+        }
+        if (d.model_id >= 0) {
+            out << ",\"model\":" << d.model_id;
+        }
+        out << "}";
+    }
+
+    // flushed per frame so consumers of a pipe see results right away
+    out << "]}\n" << std::flush;
+}
+
+}  // namespace vision
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <fstream>
+#include <iosfwd>
+#include <string>
+
+#include "pipeline.h"
+
+namespace vision {
+
+// Writes one JSON object per processed frame, one per line
+class ResultsSink {
+   public:
+    // "-" writes to stdout
+    explicit ResultsSink(const std::string& path);
+
+    void write(const Snapshot& snapshot);
+
+   private:
+    std::ofstream _file;
+    std::ostream* _out;
+};
+
+}  // namespace vision
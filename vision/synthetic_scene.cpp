@@ -0,0 +1,230 @@
+#include "synthetic_scene.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <stdexcept>
+#include <thread>
+
+namespace vision {
+
+namespace {
+
+constexpr float DEPTH_SCALE = 0.001f;
+// the wall, the floor comes closer towards the bottom of the frame
+constexpr float WALL_DISTANCE = 4.f;
+constexpr float FLOOR_NEAREST = 1.5f;
+// objects are always in front of the wall and the floor
+constexpr float OBJECT_NEAREST = 0.6f;
+constexpr float OBJECT_FARTHEST = 1.4f;
+// pixels without depth, like the holes of a real depth stream
+constexpr double DEPTH_HOLES = 0.01;
+
+// folds a position back and forth into [0, range]
+float bounce(float position, float range) {
+    if (range <= 0.f) {
+        return 0.f;
+    }
+    auto folded = std::fmod(position, 2.f * range);
+    if (folded < 0.f) {
+        folded += 2.f * range;
+    }
+    return folded <= range ? folded : 2.f * range - folded;
+}
+
+std::uint16_t to_z16(float meters) {
+    return static_cast<std::uint16_t>(std::lround(meters / DEPTH_SCALE));
+}
+
+// one slab holds the color, depth and infrared images of a frame
+std::size_t slab_size(const SyntheticSceneConfig& config) {
+    if (config.width <= 0 || config.height <= 0) {
+        throw std::invalid_argument{"Synthetic scene needs a positive size"};
+    }
+    const auto area = static_cast<std::size_t>(config.width) * config.height;
+    return align_frame(area * 3) + align_frame(area * 2) + align_frame(area);
+}
+
+// noise over a checkerboard of a random color and cell size
+cv::Mat make_texture(cv::Size size, cv::RNG& rng) {
+    const auto base = cv::Scalar(rng.uniform(40, 216), rng.uniform(40, 216),
+                                 rng.uniform(40, 216));
+    const auto cell = rng.uniform(8, 25);
+
+    auto texture = cv::Mat(size, CV_8UC3, base);
+    for (int y = 0; y < size.height; y += cell) {
+        for (int x = (y / cell % 2) * cell; x < size.width; x += 2 * cell) {
+            const auto rect = cv::Rect(x, y, cell, cell) &
+                              cv::Rect(0, 0, size.width, size.height);
+            texture(rect) *= 0.5;
+        }
+    }
+    auto noise = cv::Mat(size, CV_8UC3);
+    rng.fill(noise, cv::RNG::UNIFORM, 0, 40);
+    texture += noise;
+    return texture;
+}
+
+}  // namespace
+
+SyntheticScene::SyntheticScene(SyntheticSceneConfig config)
+    : _config(config),
+      _pool(slab_size(config)),
+      _tp_next(std::chrono::steady_clock::now()) {
+    const auto w = _config.width;
+    const auto h = _config.height;
+    auto rng = cv::RNG(_config.seed);
+
+    _background = cv::Mat(h, w, CV_8UC3);
+    rng.fill(_background, cv::RNG::UNIFORM, 0, 256);
+    cv::GaussianBlur(_background, _background, cv::Size(7, 7), 0);
+
+    // the floor's distance falls off with the inverse of the rows below the
+    // horizon, like a plane seen by a level pinhole camera
+    _background_depth = cv::Mat(h, w, CV_16U);
+    const auto horizon = static_cast<int>(h * 0.45f);
+    for (int y = 0; y < h; ++y) {
+        auto distance = WALL_DISTANCE;
+        if (y > horizon) {
+            const auto below = static_cast<float>(y - horizon) / (h - horizon);
+            const auto inverse =
+                1.f / WALL_DISTANCE +
+                below * (1.f / FLOOR_NEAREST - 1.f / WALL_DISTANCE);
+            distance = 1.f / inverse;
+        }
+        _background_depth.row(y).setTo(to_z16(distance));
+    }
+    auto holes = cv::Mat(h, w, CV_32F);
+    rng.fill(holes, cv::RNG::UNIFORM, 0.0, 1.0);
+    _background_depth.setTo(0, holes < DEPTH_HOLES);
+
+    const auto& sprites = _config.sprites;
+    for (const auto& sprite : sprites) {
+        if (sprite.empty() || sprite.type() != CV_8UC3) {
+            throw std::invalid_argument{"Sprites have to be BGR images"};
+        }
+    }
+
+    for (int i = 0; i < _config.objects_num; ++i) {
+        auto size = cv::Size(
+            std::max(1, static_cast<int>(w * rng.uniform(0.08, 0.25))),
+            std::max(1, static_cast<int>(h * rng.uniform(0.1, 0.35))));
+        const auto is_ellipse = rng.uniform(0, 2) == 1;
+        const auto speed = w * rng.uniform(0.002f, 0.008f);
+        const auto angle = rng.uniform(0.f, static_cast<float>(2 * CV_PI));
+
+        cv::Mat texture;
+        if (!sprites.empty()) {
+            // keeps the sprite's aspect ratio, a squashed object is harder
+            // to recognize than a real one
+            const auto& sprite = sprites[i % sprites.size()];
+            const auto aspect = static_cast<float>(sprite.cols) / sprite.rows;
+            size.width =
+                std::clamp(static_cast<int>(size.height * aspect), 1, w);
+            size.height =
+                std::clamp(static_cast<int>(size.width / aspect), 1, h);
+            cv::resize(sprite, texture, size, 0, 0, cv::INTER_AREA);
+        } else {
+            texture = make_texture(size, rng);
+        }
+
+        auto mask = cv::Mat(size, CV_8U, cv::Scalar(255));
+        if (is_ellipse && sprites.empty()) {
+            mask.setTo(0);
+            cv::ellipse(mask,
+                        cv::Point(size.width / 2, size.height / 2),
+                        cv::Size(size.width / 2, size.height / 2), 0, 0, 360,
+                        cv::Scalar(255), cv::FILLED);
+        }
+
+        _shapes.push_back(
+            {.texture = std::move(texture),
+             .mask = std::move(mask),
+             .origin = cv::Point2f(rng.uniform(0.f, 1.f) * (w - size.width),
+                                   rng.uniform(0.f, 1.f) * (h - size.height)),
+             .velocity = cv::Point2f(speed * std::cos(angle),
+                                     speed * std::sin(angle)),
+             .distance = rng.uniform(OBJECT_NEAREST, OBJECT_FARTHEST)});
+    }
+    std::sort(_shapes.begin(), _shapes.end(),
+              [](const Shape& a, const Shape& b) {
+                  return a.distance > b.distance;
+              });
+
+    // about 69 degrees horizontally, like the color camera of a D435
+    _intrinsics.width = w;
+    _intrinsics.height = h;
+    _intrinsics.ppx = w / 2.f;
+    _intrinsics.ppy = h / 2.f;
+    _intrinsics.fx = 0.73f * w;
+    _intrinsics.fy = 0.73f * w;
+    _intrinsics.model = RS2_DISTORTION_NONE;
+}
+
+std::optional<Frames> SyntheticScene::wait_for_frames() {
+    if (_config.fps > 0.f) {
+        const auto period =
+            std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                std::chrono::duration<float>(1.f / _config.fps));
+        _tp_next =
+            std::max(_tp_next + period, std::chrono::steady_clock::now());
+        std::this_thread::sleep_until(_tp_next);
+    }
+
+    const auto size = cv::Size(_config.width, _config.height);
+    const auto depth_offset = align_frame(size.area() * 3);
+    const auto ir_offset = depth_offset + align_frame(size.area() * 2);
+
+    auto buffer = _pool.acquire();
+    auto color = cv::Mat(size, CV_8UC3, buffer.data());
+    auto depth = cv::Mat(size, CV_16U, buffer.data() + depth_offset);
+    auto ir = cv::Mat(size, CV_8UC1, buffer.data() + ir_offset);
+    render(_number, color, depth, ir);
+
+    const auto timestamp = std::chrono::duration<double, std::milli>(
+        std::chrono::steady_clock::now().time_since_epoch());
+    return Frames{std::move(buffer),
+                  std::move(color),
+                  std::move(depth),
+                  std::move(ir),
+                  DEPTH_SCALE,
+                  _number++,
+                  timestamp.count(),
+                  _intrinsics};
+}
+
+float SyntheticScene::depth_scale() const { return DEPTH_SCALE; }
+
+std::vector<SceneObject> SyntheticScene::objects_at(
+    unsigned long long number) const {
+    std::vector<SceneObject> objects;
+    objects.reserve(_shapes.size());
+    for (std::size_t i = 0; i < _shapes.size(); ++i) {
+        const auto& shape = _shapes[i];
+        const auto size = shape.texture.size();
+        const auto x = bounce(shape.origin.x + shape.velocity.x * number,
+                              _config.width - size.width);
+        const auto y = bounce(shape.origin.y + shape.velocity.y * number,
+                              _config.height - size.height);
+        objects.push_back({.id = static_cast<int>(i),
+                           .box = cv::Rect(cv::Point(x, y), size),
+                           .distance = shape.distance});
+    }
+    return objects;
+}
+
+void SyntheticScene::render(unsigned long long number, cv::Mat& color,
+                            cv::Mat& depth, cv::Mat& ir) const {
+    _background.copyTo(color);
+    _background_depth.copyTo(depth);
+    const auto objects = objects_at(number);
+    for (std::size_t i = 0; i < objects.size(); ++i) {
+        const auto& shape = _shapes[i];
+        const auto& box = objects[i].box;
+        shape.texture.copyTo(color(box), shape.mask);
+        depth(box).setTo(to_z16(shape.distance), shape.mask);
+    }
+    cv::cvtColor(color, ir, cv::COLOR_BGR2GRAY);
+}
+
+}  // namespace vision
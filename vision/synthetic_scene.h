@@ -0,0 +1,82 @@
+#pragma once
+
+#include <chrono>
+#include <vector>
+
+#include <opencv2/opencv.hpp>
+
+#include "camera.h"
+#include "frame_pool.h"
+
+namespace vision {
+
+struct SyntheticSceneConfig {
+    int width = 848;
+    int height = 480;
+    // 0 delivers frames as fast as they are consumed
+    float fps = 0.f;
+    int objects_num = 4;
+    // scenes with the same seed and size generate the same frames
+    unsigned int seed = 0x5eed;
+    // BGR pictures of real objects drawn as the objects in turn, scaled to
+    // their boxes; textured shapes a model wouldn't recognize when empty
+    std::vector<cv::Mat> sprites;
+};
+
+// an object of a synthetic frame, for checking detections against
+struct SceneObject {
+    int id;
+    // bounding box of the whole object, nearer objects may cover part of it
+    cv::Rect box;
+    // meters, the depth of every pixel of the object
+    float distance;
+};
+
+// Frames without a camera: textured rectangles and ellipses, or the given
+// sprites, bouncing around in front of a textured wall and floor. Depth is
+// consistent with what is drawn, nearer objects cover farther ones in every
+// stream, and the infrared image is the color one in gray. Frames are
+// rendered into a frame pool and timestamped with the steady clock, so the
+// latency of a frame is the time since its timestamp. Independent instances
+// can be run side by side to simulate several cameras.
+class SyntheticScene : public FrameSource {
+   public:
+    explicit SyntheticScene(SyntheticSceneConfig config = {});
+
+    std::optional<Frames> wait_for_frames() override;
+    float depth_scale() const override;
+
+    // where the objects are in a frame, farthest first; follows from the
+    // frame number alone, so it can be called from any thread
+    std::vector<SceneObject> objects_at(unsigned long long number) const;
+
+    const SyntheticSceneConfig& config() const { return _config; }
+
+   private:
+    struct Shape {
+        cv::Mat texture;
+        // of the texture, zero outside of ellipses and set for sprites
+        cv::Mat mask;
+        // pixels and pixels per frame of the top left corner
+        cv::Point2f origin;
+        cv::Point2f velocity;
+        float distance;
+    };
+
+    void render(unsigned long long number, cv::Mat& color, cv::Mat& depth,
+                cv::Mat& ir) const;
+
+    SyntheticSceneConfig _config;
+    cv::Mat _background;
+    cv::Mat _background_depth;
+    // farthest first, the order they are drawn in
+    std::vector<Shape> _shapes;
+    rs2_intrinsics _intrinsics{};
+
+    // capture thread only
+    FramePool _pool;
+    unsigned long long _number = 0;
+    std::chrono::steady_clock::time_point _tp_next;
+};
+
+}  // namespace vision
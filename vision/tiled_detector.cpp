@@ -0,0 +1,120 @@
+#include "tiled_detector.h"
+
+#include <algorithm>
+#include <future>
+#include <iterator>
+#include <stdexcept>
+
+#include "detail/crops.h"
+#include "detail/nms.h"
+#include "perf/metrics.h"
+
+namespace vision {
+
+TiledDetector::TiledDetector(std::vector<Detector> pool, TilingConfig config)
+    : _pool(std::move(pool)), _config(config) {
+    if (_pool.empty()) {
+        throw std::runtime_error{"Tiled detector needs at least one detector"};
+    }
+}
+
+void TiledDetector::swap_runtimes(std::span<ModelRuntime> runtimes) {
+    if (runtimes.size() != _pool.size()) {
+        throw std::runtime_error{"Tiled detector needs " +
+                                 std::to_string(_pool.size()) +
+                                 " runtimes to swap, got " +
+                                 std::to_string(runtimes.size())};
+    }
+    for (std::size_t i = 0; i < _pool.size(); ++i) {
+        _pool[i].swap_runtime(runtimes[i]);
+    }
+}
+
+std::vector<Detection> TiledDetector::detect(const cv::Mat& bgr,
+                                             const Thresholds& thresholds,
+                                             const DepthGate* depth_gate) {
+    _tiles = plan_tiles(bgr.size(), _config.tile_size, _config.overlap);
+    if (depth_gate != nullptr) {
+        const auto skipped = std::erase_if(_tiles, [&](const cv::Rect& tile) {
+            return depth_gate->is_empty(tile);
+        });
+        perf::metrics().add(perf::Counter::DepthSkips, skipped);
+    }
+    if (_tiles.empty()) {
+        return {};
+    }
+    for (auto& detector : _pool) {
+        detector.set_depth_gate(depth_gate);
+    }
+
+    // detector k takes tiles k, k + pool size, ... so every model instance
+    // is used by one thread at a time
+    const auto run = [&](std::size_t k) {
+        auto& detector = _pool[k];
+        std::vector<Detection> detections;
+        for (auto i = k; i < _tiles.size(); i += _pool.size()) {
+            detector.input(bgr, _tiles[i], detector.input_size());
+            detector.forward();
+            auto tile_detections = detector.parse(thresholds);
+            std::move(tile_detections.begin(), tile_detections.end(),
+                      std::back_inserter(detections));
+        }
+        return detections;
+    };
+
+    const auto workers = std::min(_pool.size(), _tiles.size());
+    std::vector<std::future<std::vector<Detection>>> futures;
+    futures.reserve(workers);
+    for (std::size_t k = 1; k < workers; ++k) {
+        futures.push_back(std::async(std::launch::async, run, k));
+    }
+    // the calling thread takes a share instead of waiting idle
+    auto detections = run(0);
+    for (auto& future : futures) {
+        auto tile_detections = future.get();
+        std::move(tile_detections.begin(), tile_detections.end(),
+                  std::back_inserter(detections));
+    }
+
+    return merge(std::move(detections), thresholds);
+}
+
+std::vector<Detection> TiledDetector::merge(
+    std::vector<Detection>&& detections, const Thresholds& thresholds) const {
+    if (_tiles.size() <= 1) {
+        return std::move(detections);
+    }
+
+    const auto timer = perf::ScopedTimer{perf::Stage::Nms};
+
+    // only boxes reaching into more than one tile can have been found twice,
+    // the rest skips NMS
+    std::vector<Detection> result;
+    DetectionsRaw boundary;
+    std::vector<std::size_t> boundary_index;
+    int class_num = 0;
+    for (std::size_t i = 0; i < detections.size(); ++i) {
+        const auto& d = detections[i];
+        const auto tiles_hit = std::count_if(
+            _tiles.begin(), _tiles.end(),
+            [&](const cv::Rect& tile) { return !(tile & d.box).empty(); });
+        if (tiles_hit <= 1) {
+            result.push_back(std::move(detections[i]));
+            continue;
+        }
+        boundary.class_ids.push_back(d.class_id);
+        boundary.scores.push_back(d.score);
+        boundary.boxes.push_back(d.box);
+        boundary_index.push_back(i);
+        class_num = std::max(class_num, d.class_id + 1);
+    }
+
+    const auto is_class_agnostic = _pool.front().is_nms_class_agnostic;
+    for (const auto k :
+         apply_nms(boundary, thresholds, class_num, is_class_agnostic)) {
+        result.push_back(std::move(detections[boundary_index[k]]));
+    }
+    return result;
+}
+
+}  // namespace vision
@@ -0,0 +1,236 @@
+#include "tracker.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "detail/nms.h"
+
+namespace {
+
+// boxes of the same class overlapping less than this are different objects
+constexpr float MIN_IOU = 0.3f;
+// keyframes a track survives without being detected
+constexpr int MAX_MISSES = 2;
+
+// variances in pixels, positions are trusted more than velocities
+constexpr float POSITION_NOISE = 1.f;
+constexpr float VELOCITY_NOISE = 0.5f;
+constexpr float MEASUREMENT_NOISE = 10.f;
+constexpr float INITIAL_VELOCITY_VARIANCE = 100.f;
+
+using State = cv::Matx<float, 8, 1>;
+using Covariance = cv::Matx<float, 8, 8>;
+using Measurement = cv::Matx<float, 4, 1>;
+
+Covariance transition() {
+    auto f = Covariance::eye();
+    for (int i = 0; i < 4; ++i) {
+        f(i, i + 4) = 1.f;
+    }
+    return f;
+}
+
+const Covariance F = transition();
+
+const Covariance Q = Covariance::diag(
+    cv::Vec<float, 8>(POSITION_NOISE, POSITION_NOISE, POSITION_NOISE,
+                      POSITION_NOISE, VELOCITY_NOISE, VELOCITY_NOISE,
+                      VELOCITY_NOISE, VELOCITY_NOISE));
+
+const cv::Matx<float, 4, 8> H = cv::Matx<float, 4, 8>::eye();
+
+const cv::Matx<float, 4, 4> R =
+    cv::Matx<float, 4, 4>::eye() * MEASUREMENT_NOISE;
+
+Measurement measure(const cv::Rect& box) {
+    return Measurement(box.x + box.width * 0.5f, box.y + box.height * 0.5f,
+                       static_cast<float>(box.width),
+                       static_cast<float>(box.height));
+}
+
+}  // namespace
+
+namespace vision {
+
+void Tracker::update(const std::vector<Detection>& detections) {
+    predict();
+
+    _is_matched.fill(false);
+    _is_detection_matched.assign(detections.size(), false);
+
+    // greedy association, the best overlapping pair is matched first
+    while (true) {
+        std::size_t best_track = CAPACITY;
+        std::size_t best_detection = 0;
+        auto best_iou = MIN_IOU;
+        for (std::size_t t = 0; t < CAPACITY; ++t) {
+            const auto& track = _tracks[t];
+            if (!track.is_active || _is_matched[t]) {
+                continue;
+            }
+            const auto box = box_of(track);
+            for (std::size_t d = 0; d < detections.size(); ++d) {
+                if (_is_detection_matched[d] ||
+                    detections[d].class_id != track.class_id ||
+                    detections[d].model_id != track.model_id) {
+                    continue;
+                }
+                const auto iou = box_iou(box, detections[d].box);
+                if (iou >= best_iou) {
+                    best_track = t;
+                    best_detection = d;
+                    best_iou = iou;
+                }
+            }
+        }
+        if (best_track == CAPACITY) {
+            break;
+        }
+
+        auto& track = _tracks[best_track];
+        const auto& detection = detections[best_detection];
+        correct(track, detection.box);
+        track.score = detection.score;
+        track.misses = 0;
+        _is_matched[best_track] = true;
+        _is_detection_matched[best_detection] = true;
+    }
+
+    for (std::size_t t = 0; t < CAPACITY; ++t) {
+        auto& track = _tracks[t];
+        if (track.is_active && !_is_matched[t] && ++track.misses > MAX_MISSES) {
+            track.is_active = false;
+        }
+    }
+
+    for (std::size_t d = 0; d < detections.size(); ++d) {
+        if (_is_detection_matched[d]) {
+            continue;
+        }
+        const auto free = std::find_if(
+            _tracks.begin(), _tracks.end(),
+            [](const Track& track) { return !track.is_active; });
+        if (free == _tracks.end()) {
+            // more objects than tracks, the rest shows up on keyframes only
+            break;
+        }
+        start(*free, detections[d]);
+    }
+}
+
+void Tracker::predict() {
+    for (auto& track : _tracks) {
+        if (track.is_active) {
+            track.state = F * track.state;
+            track.covariance = F * track.covariance * F.t() + Q;
+        }
+    }
+}
+
+void Tracker::clear() {
+    for (auto& track : _tracks) {
+        track.is_active = false;
+    }
+}
+
+void Tracker::get(std::vector<Detection>& out) const {
+    out.clear();
+    for (const auto& track : _tracks) {
+        if (!track.is_active) {
+            continue;
+        }
+        out.push_back(Detection{.label = track.label,
+                                .score = track.score,
+                                .box = box_of(track),
+                                .class_id = track.class_id,
+                                .track_id = track.id,
+                                .model_id = track.model_id});
+    }
+}
+
+float Tracker::motion() const {
+    float sum = 0.f;
+    int count = 0;
+    for (const auto& track : _tracks) {
+        if (!track.is_active) {
+            continue;
+        }
+        const auto& x = track.state;
+        const auto speed = std::hypot(x(4), x(5));
+        const auto size = std::sqrt(std::max(1.f, x(2) * x(3)));
+        sum += speed / size;
+        ++count;
+    }
+    return count > 0 ? sum / count : 0.f;
+}
+
+void Tracker::start(Track& track, const Detection& detection) {
+    const auto z = measure(detection.box);
+
+    track.is_active = true;
+    track.id = _next_id++;
+    track.class_id = detection.class_id;
+    track.model_id = detection.model_id;
+    // reuses the string's buffer of the track which lived here before
+    track.label = detection.label;
+    track.score = detection.score;
+    track.misses = 0;
+    track.state = State(z(0), z(1), z(2), z(3), 0.f, 0.f, 0.f, 0.f);
+    track.covariance = Covariance::diag(cv::Vec<float, 8>(
+        MEASUREMENT_NOISE, MEASUREMENT_NOISE, MEASUREMENT_NOISE,
+        MEASUREMENT_NOISE, INITIAL_VELOCITY_VARIANCE,
+        INITIAL_VELOCITY_VARIANCE, INITIAL_VELOCITY_VARIANCE,
+        INITIAL_VELOCITY_VARIANCE));
+}
+
+void Tracker::correct(Track& track, const cv::Rect& box) {
+    const auto innovation = measure(box) - H * track.state;
+    const auto s = H * track.covariance * H.t() + R;
+    const auto gain = track.covariance * H.t() * s.inv();
+    track.state += gain * innovation;
+    track.covariance = (Covariance::eye() - gain * H) * track.covariance;
+}
+
+cv::Rect Tracker::box_of(const Track& track) {
+    const auto& x = track.state;
+    const auto w = std::max(1.f, x(2));
+    const auto h = std::max(1.f, x(3));
+    return cv::Rect(cvRound(x(0) - w * 0.5f), cvRound(x(1) - h * 0.5f),
+                    cvRound(w), cvRound(h));
+}
+
+bool KeyframeScheduler::next() {
+    if (_is_forced || ++_since_keyframe >= _interval) {
+        _is_forced = false;
+        _since_keyframe = 0;
+        return true;
+    }
+    return false;
+}
+
+void KeyframeScheduler::on_keyframe(float inference_ms, float motion) {
+    _inference_ms = _inference_ms == 0.f
+                        ? inference_ms
+                        : 0.8f * _inference_ms + 0.2f * inference_ms;
+
+    // clamped before converting, the quotients don't fit an int for a
+    // barely moving scene or a stalled model
+    const auto to_interval = [this](float interval) {
+        interval = std::max(interval, 1.f);
+        return interval < static_cast<float>(_config.max_interval)
+                   ? static_cast<int>(interval)
+                   : _config.max_interval;
+    };
+    const auto budget_interval = to_interval(
+        std::ceil(_inference_ms / std::max(_config.latency_budget_ms, 0.1f)));
+    const auto motion_interval =
+        motion > 0.f ? to_interval(_config.motion_tolerance / motion)
+                     : _config.max_interval;
+
+    _interval = std::clamp(std::max(budget_interval, motion_interval), 1,
+                           _config.max_interval);
+}
+
+void KeyframeScheduler::reset() { _is_forced = true; }
+
+}  // namespace vision
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include <opencv2/opencv.hpp>
+
+#include "parsers/parser.h"
+
+namespace vision {
+
+// Follows detections between keyframes with a constant velocity Kalman
+// filter per box and IoU association. Tracks live in a fixed array and keep
+// their label strings between frames, so nothing is allocated once the
+// tracker has warmed up.
+class Tracker {
+   public:
+    static constexpr std::size_t CAPACITY = 64;
+
+    // associates keyframe detections with the tracks, starts tracks for the
+    // new ones and drops tracks missed too many keyframes in a row
+    void update(const std::vector<Detection>& detections);
+    // advances every track by one frame
+    void predict();
+    void clear();
+
+    // the tracked boxes with their track ids, reusing the vector's storage
+    void get(std::vector<Detection>& out) const;
+    // how far boxes move per frame relative to their size, averaged over
+    // the tracks
+    float motion() const;
+
+   private:
+    using State = cv::Matx<float, 8, 1>;  // cx, cy, w, h and velocities
+    using Covariance = cv::Matx<float, 8, 8>;
+
+    struct Track {
+        bool is_active = false;
+        int id = 0;
+        int class_id = -1;
+        int model_id = -1;
+        std::string label;
+        float score = 0.f;
+        // keyframes in a row the track wasn't detected on
+        int misses = 0;
+        State state;
+        Covariance covariance;
+    };
+
+    void start(Track& track, const Detection& detection);
+    static void correct(Track& track, const cv::Rect& box);
+    static cv::Rect box_of(const Track& track);
+
+    std::array<Track, CAPACITY> _tracks;
+    int _next_id = 1;
+
+    // scratch for the association, grows to the largest keyframe once
+    std::array<bool, CAPACITY> _is_matched{};
+    std::vector<bool> _is_detection_matched;
+};
+
+struct KeyframeConfig {
+    // average time inference may add to every frame
+    float latency_budget_ms = 8.f;
+    // keyframes are never further apart, even if the budget needs it
+    int max_interval = 10;
+    // how far, in box sizes, objects may move between keyframes
+    float motion_tolerance = 0.5f;
+};
+
+// Decides which frames run the detector. Slow inference spreads keyframes
+// out to stay within the latency budget, fast moving scenes pull them closer
+// together. The budget wins when both disagree.
+class KeyframeScheduler {
+   public:
+    explicit KeyframeScheduler(KeyframeConfig config = {}) : _config(config) {}
+
+    // true when the current frame has to run the detector
+    bool next();
+    void on_keyframe(float inference_ms, float motion);
+    // runs the detector on the next frame
+    void reset();
+
+    int interval() const { return _interval; }
+
+   private:
+    KeyframeConfig _config;
+    int _interval = 1;
+    int _since_keyframe = 0;
+    bool _is_forced = true;
+    // smoothed over keyframes so a single slow inference doesn't swing N
+    float _inference_ms = 0.f;
+};
+
+}  // namespace vision